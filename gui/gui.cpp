@@ -1,9 +1,22 @@
 #include "gui.h"
 #include "../src/core/movegen.h"
 #include <iostream>
+#include <thread>
 
 namespace gui {
 
+namespace {
+
+chess::SearchLimits ai_limits() {
+    chess::SearchLimits limits;
+    limits.max_depth = 20;
+    limits.time_ms = 3000;
+    limits.threads = 0;   // the engine's thread count
+    return limits;
+}
+
+} // namespace
+
 GameController::GameController()
     : window_(sf::VideoMode(Renderer::WINDOW_WIDTH, Renderer::WINDOW_HEIGHT),
               "CheStrat Chess Engine",
@@ -12,6 +25,7 @@ GameController::GameController()
 {
     window_.setFramerateLimit(60);
     renderer_.load_textures("assets/pieces");
+    engine_.set_threads(int(std::thread::hardware_concurrency()));
 }
 
 void GameController::new_game(chess::Color human_color) {
@@ -23,35 +37,113 @@ void GameController::new_game(chess::Color human_color) {
     ai_depth_ = 0;
     ai_score_ = 0;
     ai_nodes_ = 0;
+    ai_pv_.clear();
 
     if (engine_.board().side_to_move() != human_color_) {
         state_ = GameState::AI_THINKING;
         start_ai_turn();
     } else {
         state_ = GameState::HUMAN_TURN;
+        start_pondering();
     }
 }
 
+void GameController::on_search_info(const chess::SearchInfo& info) {
+    std::lock_guard<std::mutex> lock(info_mutex_);
+    ai_depth_ = info.depth;
+    ai_score_ = info.score;
+    ai_nodes_ = info.nodes;
+    ai_pv_ = info.pv;
+}
+
 void GameController::start_ai_turn() {
     state_ = GameState::AI_THINKING;
     render_board_ = engine_.board();
+    engine_.arm_thinking();
     ai_future_ = std::async(std::launch::async, [this]() {
-        chess::SearchLimits limits;
-        limits.max_depth = 20;
-        limits.time_ms = 3000;
-        return engine_.think(limits, [this](const chess::SearchInfo& info) {
-            std::lock_guard<std::mutex> lock(info_mutex_);
-            ai_depth_ = info.depth;
-            ai_score_ = info.score;
-            ai_nodes_ = info.nodes;
-        });
+        return engine_.think(ai_limits(), [this](const chess::SearchInfo& info) { on_search_info(info); });
+    });
+}
+
+// Called at the start of the human's turn. The engine searches on the
+// reply its last PV expects, or analyses the human's position when it
+// has none, until the human moves; the search fills the TT either way.
+void GameController::start_pondering() {
+    render_board_ = engine_.board();
+    ponder_move_ = chess::Move::none();
+
+    chess::Move expected = chess::Move::none();
+    {
+        std::lock_guard<std::mutex> lock(info_mutex_);
+        if (ai_pv_.size() >= 2) expected = ai_pv_[1];
+    }
+    if (expected && engine_.apply_move(expected)) {
+        if (engine_.is_game_over()) {
+            engine_.undo_move(expected);
+        } else {
+            ponder_move_ = expected;
+            ponder_board_ = engine_.board();
+        }
+    }
+
+    chess::SearchLimits limits = ai_limits();
+    limits.ponder = true;
+    pondering_ = true;
+    engine_.arm_thinking();
+    ai_future_ = std::async(std::launch::async, [this, limits]() {
+        return engine_.think(limits, [this](const chess::SearchInfo& info) { on_search_info(info); });
     });
 }
 
+// Stops the AI or ponder search, if any, and waits for it so the engine's
+// board is free again. What the search stored in the TT stays there.
+void GameController::stop_search() {
+    if (!ai_future_.valid()) return;
+
+    engine_.stop_thinking();
+    ai_future_.get();
+
+    if (pondering_) {
+        pondering_ = false;
+        if (ponder_move_) engine_.undo_move(ponder_move_);
+        ponder_move_ = chess::Move::none();
+    }
+}
+
+void GameController::play_human_move(chess::Move m) {
+    last_move_ = m;
+    selected_ = chess::SQ_NONE;
+
+    // Ponder hit: the running search already has m played and carries on
+    // as the AI's search, on the normal time limit from now
+    if (pondering_ && ponder_move_ && m == ponder_move_) {
+        pondering_ = false;
+        ponder_move_ = chess::Move::none();
+        render_board_ = ponder_board_;
+        state_ = GameState::AI_THINKING;
+        engine_.ponderhit();
+        return;
+    }
+
+    stop_search();
+    engine_.apply_move(m);
+    if (engine_.is_game_over()) {
+        state_ = GameState::GAME_OVER;
+    } else {
+        start_ai_turn();
+    }
+}
+
+// The engine's board belongs to the search while one runs; input and
+// drawing use the snapshot taken when it started
+const chess::Board& GameController::position() const {
+    return ai_future_.valid() ? render_board_ : engine_.board();
+}
+
 std::string GameController::get_status_text() const {
     switch (state_) {
         case GameState::HUMAN_TURN:
-            if (engine_.board().in_check())
+            if (position().in_check())
                 return "Your turn - CHECK!";
             return "Your turn";
         case GameState::AI_THINKING: {
@@ -67,8 +159,12 @@ std::string GameController::get_status_text() const {
                 chess::Color winner = ~engine_.board().side_to_move();
                 return (winner == human_color_) ? "Checkmate - You win!" : "Checkmate - AI wins!";
             }
-            if (engine_.is_stalemate()) return "Stalemate - Draw!";
-            return "Draw (50-move rule)";
+            switch (engine_.draw_reason()) {
+                case chess::DrawReason::STALEMATE:  return "Stalemate - Draw!";
+                case chess::DrawReason::REPETITION: return "Draw (threefold repetition)";
+                case chess::DrawReason::MATERIAL:   return "Draw (insufficient material)";
+                default:                            return "Draw (50-move rule)";
+            }
     }
     return "";
 }
@@ -79,11 +175,12 @@ void GameController::handle_click(int x, int y) {
     if (sq_pos.x < 0) return;
 
     chess::Square clicked = chess::make_square(sq_pos.x, sq_pos.y);
-    chess::MoveList legal = engine_.legal_moves();
+    chess::MoveList legal;
+    chess::generate_legal_moves(position(), legal);
 
     if (selected_ == chess::SQ_NONE) {
         // Select a piece
-        chess::Piece p = engine_.board().piece_on(clicked);
+        chess::Piece p = position().piece_on(clicked);
         if (p != chess::NO_PIECE && chess::piece_color(p) == human_color_) {
             // Check if this piece has any legal moves
             bool has_moves = false;
@@ -94,7 +191,6 @@ void GameController::handle_click(int x, int y) {
         }
     } else {
         // Try to make a move
-        bool moved = false;
         for (int i = 0; i < legal.count; ++i) {
             chess::Move m = legal.moves[i];
             if (m.from() == selected_ && m.to() == clicked) {
@@ -106,21 +202,12 @@ void GameController::handle_click(int x, int y) {
                     selected_ = chess::SQ_NONE;
                     return;
                 }
-                engine_.apply_move(m);
-                last_move_ = m;
-                selected_ = chess::SQ_NONE;
-                moved = true;
-
-                if (engine_.is_game_over()) {
-                    state_ = GameState::GAME_OVER;
-                } else {
-                    start_ai_turn();
-                }
+                play_human_move(m);
                 return;
             }
         }
         // If clicked on own piece, reselect
-        chess::Piece p = engine_.board().piece_on(clicked);
+        chess::Piece p = position().piece_on(clicked);
         if (p != chess::NO_PIECE && chess::piece_color(p) == human_color_) {
             selected_ = clicked;
         } else {
@@ -149,38 +236,31 @@ void GameController::handle_promotion_click(int x, int y) {
 
     // Build the correct promotion move
     chess::Square from = pending_promo_move_.from();
-    bool is_cap = engine_.board().piece_on(promo_square_) != chess::NO_PIECE;
+    bool is_cap = position().piece_on(promo_square_) != chess::NO_PIECE;
     // Check if it's a capture promotion
     int base = is_cap ? chess::PROMO_CAPTURE_KNIGHT : chess::PROMO_KNIGHT;
     chess::MoveFlag flag = chess::MoveFlag(base + int(promo) - int(chess::KNIGHT));
 
     chess::Move m(from, promo_square_, flag);
-    engine_.apply_move(m);
-    last_move_ = m;
     pending_promo_move_ = chess::Move::none();
-
-    if (engine_.is_game_over()) {
-        state_ = GameState::GAME_OVER;
-    } else {
-        start_ai_turn();
-    }
+    play_human_move(m);
 }
 
 void GameController::handle_event(const sf::Event& event) {
     if (event.type == sf::Event::Closed) {
-        if (state_ == GameState::AI_THINKING) engine_.stop_thinking();
+        stop_search();
         window_.close();
         return;
     }
 
     if (event.type == sf::Event::KeyPressed) {
         if (event.key.code == sf::Keyboard::N) {
-            if (state_ == GameState::AI_THINKING) engine_.stop_thinking();
+            stop_search();
             new_game(human_color_);
             return;
         }
         if (event.key.code == sf::Keyboard::F) {
-            if (state_ == GameState::AI_THINKING) engine_.stop_thinking();
+            stop_search();
             new_game(~human_color_);
             return;
         }
@@ -198,8 +278,7 @@ void GameController::handle_event(const sf::Event& event) {
 void GameController::render() {
     bool flipped = (human_color_ == chess::BLACK);
 
-    // Use snapshot during AI search to avoid race condition
-    const chess::Board& board = (state_ == GameState::AI_THINKING) ? render_board_ : engine_.board();
+    const chess::Board& board = position();
 
     window_.clear();
     renderer_.draw_board();
@@ -210,7 +289,8 @@ void GameController::render() {
     }
 
     if (state_ == GameState::HUMAN_TURN) {
-        chess::MoveList legal = engine_.legal_moves();
+        chess::MoveList legal;
+        chess::generate_legal_moves(board, legal);
         renderer_.draw_highlights(selected_, legal, flipped);
     }
 
@@ -246,6 +326,7 @@ void GameController::run() {
                 } else {
                     state_ = GameState::HUMAN_TURN;
                     selected_ = chess::SQ_NONE;
+                    start_pondering();
                 }
             }
         }
@@ -4,6 +4,7 @@
 #include "../src/engine/engine.h"
 #include <future>
 #include <mutex>
+#include <vector>
 
 namespace gui {
 
@@ -24,6 +25,11 @@ private:
     void handle_click(int x, int y);
     void handle_promotion_click(int x, int y);
     void start_ai_turn();
+    void start_pondering();
+    void stop_search();
+    void play_human_move(chess::Move m);
+    void on_search_info(const chess::SearchInfo& info);
+    const chess::Board& position() const;
     void render();
     void new_game(chess::Color human_color);
     std::string get_status_text() const;
@@ -39,14 +45,23 @@ private:
     chess::Move pending_promo_move_ = chess::Move::none();
     chess::Square promo_square_ = chess::SQ_NONE;
 
-    // AI
+    // AI; the future belongs to either the AI's own search or a ponder
+    // search during the human's turn
     std::future<chess::Move> ai_future_;
     std::mutex info_mutex_;
     int ai_depth_ = 0;
     int ai_score_ = 0;
     uint64_t ai_nodes_ = 0;
+    std::vector<chess::Move> ai_pv_;
 
-    // Board snapshot for rendering during AI search
+    // Pondering: the engine searches while the human thinks, on the
+    // position after the reply its PV expects (ponder_move_), or on the
+    // human's position itself when there is none (ponder_move_ is none)
+    bool pondering_ = false;
+    chess::Move ponder_move_ = chess::Move::none();
+    chess::Board ponder_board_;   // position after ponder_move_
+
+    // Board snapshot for input and rendering while a search is running
     chess::Board render_board_;
 };
 
@@ -1,116 +1,262 @@
 #include "bitboard.h"
+#include <mutex>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CHESTRAT_X86_DISPATCH 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
 
 namespace chess {
 namespace bb {
 
-Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-Bitboard KnightAttacks[SQUARE_NB];
-Bitboard KingAttacks[SQUARE_NB];
-Bitboard RayTable[SQUARE_NB][8];
-Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
-Bitboard LineBB[SQUARE_NB][SQUARE_NB];
-
-// Direction vectors for ray generation
-// Order: N, NE, E, SE, S, SW, W, NW
-static constexpr int DirFile[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
-static constexpr int DirRank[8] = { 1, 1, 0,-1,-1,-1, 0, 1};
-
-static Bitboard compute_ray(Square s, int dir) {
-    Bitboard ray = 0;
-    int f = file_of(s) + DirFile[dir];
-    int r = rank_of(s) + DirRank[dir];
-    while (f >= 0 && f <= 7 && r >= 0 && r <= 7) {
-        ray |= square_bb(make_square(f, r));
-        f += DirFile[dir];
-        r += DirRank[dir];
-    }
-    return ray;
-}
+Magic BishopMagics[SQUARE_NB];
+Magic RookMagics[SQUARE_NB];
+
+SliderBackend ActiveSliderBackend = SliderBackend::MAGIC;
+
+// Backing storage for the per-square slices: sum of 2^bits(mask) over all squares
+static Bitboard BishopTable[5248];
+static Bitboard RookTable[102400];
+
+// Magic multipliers, found offline with a sparse-random trial search over the
+// relevant-occupancy masks below. Any collision-free multiplier works; these
+// are only fixed so that startup does not have to search for them.
+static constexpr Bitboard BishopMagicNumbers[SQUARE_NB] = {
+    0x40106000a1160020ULL, 0x0230106090808800ULL, 0x4010210041000800ULL, 0x02240400980c2000ULL,
+    0x1304030800402088ULL, 0x140a0f1008000002ULL, 0x0001043002088080ULL, 0x0431240044102800ULL,
+    0x0000400222021200ULL, 0x0040080880809206ULL, 0x0420044104250001ULL, 0x0008841046010a40ULL,
+    0x2000020210001000ULL, 0x4000c20190080000ULL, 0x0404020801041004ULL, 0x0004004048241040ULL,
+    0x8008802002104a20ULL, 0x08080802b0840080ULL, 0x1008082a42040020ULL, 0x2118010402142012ULL,
+    0x2002800400a08004ULL, 0x2108080082012020ULL, 0x2054038069080800ULL, 0x0000400202020110ULL,
+    0x0230404825040481ULL, 0x1030310108012102ULL, 0x8808020a11140105ULL, 0x0014040038020808ULL,
+    0x2084040018410040ULL, 0x8409420001c11030ULL, 0x000088904c020830ULL, 0x00032a0401420080ULL,
+    0xa204824014602422ULL, 0xc9021a1308e00824ULL, 0x0404020100420400ULL, 0x2800600800048820ULL,
+    0x00084a0020120080ULL, 0x00041000800c1040ULL, 0x2004081880004400ULL, 0x0042040031250091ULL,
+    0xc20a082008004400ULL, 0x1124010882122800ULL, 0x8842010101002081ULL, 0x4001044200808808ULL,
+    0x0000240102122400ULL, 0x3082240806020221ULL, 0x803010b218808040ULL, 0x1034a40400400020ULL,
+    0x4081040120690000ULL, 0x00420a12090c8500ULL, 0x0808420124090940ULL, 0x1110050042020001ULL,
+    0x0d60224099024000ULL, 0x0100084218820081ULL, 0x08882048088504a8ULL, 0x2406088f01060390ULL,
+    0x000202010c829000ULL, 0x0260010421010810ULL, 0x0004200a004208a0ULL, 0x0222000800208821ULL,
+    0x0083040004104421ULL, 0x2011808810100224ULL, 0x2102a02002208100ULL, 0x0002420441020602ULL,
+};
+
+static constexpr Bitboard RookMagicNumbers[SQUARE_NB] = {
+    0x0a80004000801220ULL, 0x10c0100040002000ULL, 0x0100102000410009ULL, 0x0b0021000c100008ULL,
+    0x4080080080040002ULL, 0x0200019004080200ULL, 0x0400080a10112684ULL, 0x20800a4d00062080ULL,
+    0x2091800020804000ULL, 0x0044401000200040ULL, 0x1001002000401108ULL, 0x1001800801100081ULL,
+    0x0001000500080010ULL, 0x1000808002000400ULL, 0x0404000482100108ULL, 0x0003000182610002ULL,
+    0x0440848002c00420ULL, 0x2010890040010021ULL, 0x8800110020044300ULL, 0x0208010100201000ULL,
+    0x1222020004102008ULL, 0x0000808002000400ULL, 0x20040400094a9008ULL, 0x0000420000804401ULL,
+    0x0040002880004680ULL, 0x0000200240100040ULL, 0x0020008180201001ULL, 0x01080080800c1000ULL,
+    0x0104040080800800ULL, 0x4800020080040080ULL, 0x0002000200840108ULL, 0x00a1000100006082ULL,
+    0x8004400088800260ULL, 0x0100804000802008ULL, 0x0010008010802002ULL, 0x000c801000800800ULL,
+    0x0c51800402800800ULL, 0x0002800200800400ULL, 0x0000820804000110ULL, 0x4003808042000401ULL,
+    0x00208020c0018000ULL, 0x4400402010004009ULL, 0x22100400a800e000ULL, 0x0e020021400a0013ULL,
+    0x10a0080100110005ULL, 0x0004010002004040ULL, 0x0024080102040010ULL, 0x4154089108420014ULL,
+    0x0182400080002380ULL, 0x0000400110802100ULL, 0x0000100080200480ULL, 0x100a000820401200ULL,
+    0x8081004020801002ULL, 0x0002000408100200ULL, 0x03223a1008010c00ULL, 0x000000831c014200ULL,
+    0x4200208009001041ULL, 0xc001004000881021ULL, 0x1008200100100841ULL, 0x0000082240920032ULL,
+    0x4002000804201102ULL, 0xb821000804000201ULL, 0x4080c208102100a4ULL, 0x02020900418c0ca2ULL,
+};
 
+// Attacks along one ray, stopping at (and including) the first blocker.
+// N, NE, E and NW rays grow towards higher squares, so their nearest
+// blocker is the lowest set bit; the other four use the highest.
 static Bitboard slide_attack(Square s, Bitboard occupied, int dir) {
+    Bitboard ray = RayTable[s][dir];
+    Bitboard blockers = ray & occupied;
+    if (!blockers) return ray;
+    bool ascending = dir <= 2 || dir == 7;
+    Square b = ascending ? lsb(blockers) : Square(63 - std::countl_zero(blockers));
+    return ray ^ RayTable[b][dir];
+}
+
+// Reference slider attacks, only used to fill the lookup tables.
+// first_dir = 0 gives rook directions (N, E, S, W), 1 gives bishop diagonals.
+static Bitboard sliding_attacks(Square s, Bitboard occupied, int first_dir) {
     Bitboard attacks = 0;
-    int f = file_of(s) + DirFile[dir];
-    int r = rank_of(s) + DirRank[dir];
-    while (f >= 0 && f <= 7 && r >= 0 && r <= 7) {
-        Bitboard sq = square_bb(make_square(f, r));
-        attacks |= sq;
-        if (sq & occupied) break;
-        f += DirFile[dir];
-        r += DirRank[dir];
-    }
+    for (int d = first_dir; d < 8; d += 2)
+        attacks |= slide_attack(s, occupied, d);
+    return attacks;
+}
+
+#ifdef CHESTRAT_X86_DISPATCH
+// PEXT is microcoded (hundreds of cycles) on AMD before Zen 3, so BMI2
+// alone is not enough to prefer it over the magic multiply.
+static bool has_fast_pext() {
+    if (!__builtin_cpu_supports("bmi2")) return false;
+
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return false;
+    bool amd = ebx == 0x68747541 && edx == 0x69746e65 && ecx == 0x444d4163; // "AuthenticAMD"
+    if (!amd) return true;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    unsigned family = (eax >> 8) & 0xF;
+    if (family == 0xF) family += (eax >> 20) & 0xFF;
+    return family >= 0x19;
+}
+#endif
+
+// ── Set-wise attacks ────────────────────────────────────────────────────
+// Portable fallback: one table lookup per piece. A scalar Kogge-Stone fill
+// costs four sequential 3-step fills per piece type and measured about twice
+// as slow as this loop for the 1-2 slider sets seen in real positions.
+template<SliderBackend B>
+static Bitboard loop_bishop_attacks_set(Bitboard bishops, Bitboard occupied) {
+    Bitboard attacks = 0;
+    while (bishops) attacks |= bishop_attacks<B>(pop_lsb(bishops), occupied);
     return attacks;
 }
 
-Bitboard bishop_attacks(Square s, Bitboard occupied) {
-    return slide_attack(s, occupied, 1) | slide_attack(s, occupied, 3) |
-           slide_attack(s, occupied, 5) | slide_attack(s, occupied, 7);
+template<SliderBackend B>
+static Bitboard loop_rook_attacks_set(Bitboard rooks, Bitboard occupied) {
+    Bitboard attacks = 0;
+    while (rooks) attacks |= rook_attacks<B>(pop_lsb(rooks), occupied);
+    return attacks;
 }
 
-Bitboard rook_attacks(Square s, Bitboard occupied) {
-    return slide_attack(s, occupied, 0) | slide_attack(s, occupied, 2) |
-           slide_attack(s, occupied, 4) | slide_attack(s, occupied, 6);
+template<SliderBackend B>
+static Bitboard loop_queen_attacks_set(Bitboard queens, Bitboard occupied) {
+    Bitboard attacks = 0;
+    while (queens) attacks |= queen_attacks<B>(pop_lsb(queens), occupied);
+    return attacks;
 }
 
-void init() {
-    // Knight offsets
-    static constexpr int KnightDf[] = {-2,-1, 1, 2, 2, 1,-1,-2};
-    static constexpr int KnightDr[] = { 1, 2, 2, 1,-1,-2,-2,-1};
+#ifdef CHESTRAT_X86_DISPATCH
+constexpr Bitboard NotFileA = ~FileA_BB;
+constexpr Bitboard NotFileH = ~FileH_BB;
+constexpr Bitboard AllSquares = ~Bitboard(0);
+
+// Kogge-Stone occluded fills. A direction is a shift amount (positive:
+// left) plus the mask of squares that can be entered without wrapping
+// around the board edge. Each fill is gen |= pro & shift(gen) repeated for
+// shifts of 1, 2 and 4 steps, then one more step so that the first blocker
+// in each ray is included.
+//
+// The four directions run as four lanes. AVX2 variable shifts go one way
+// per instruction, so each lane goes through a left and a right shift with
+// the unused one set to zero.
+template<int S0, int S1, int S2, int S3>
+__attribute__((target("avx2")))
+static inline __m256i shift_lanes(__m256i v) {
+    const __m256i left  = _mm256_setr_epi64x(S0 > 0 ? S0 : 0, S1 > 0 ? S1 : 0, S2 > 0 ? S2 : 0, S3 > 0 ? S3 : 0);
+    const __m256i right = _mm256_setr_epi64x(S0 < 0 ? -S0 : 0, S1 < 0 ? -S1 : 0, S2 < 0 ? -S2 : 0, S3 < 0 ? -S3 : 0);
+    return _mm256_srlv_epi64(_mm256_sllv_epi64(v, left), right);
+}
+
+template<int S0, int S1, int S2, int S3, Bitboard M0, Bitboard M1, Bitboard M2, Bitboard M3>
+__attribute__((target("avx2")))
+static inline Bitboard fill_attacks_avx2(Bitboard sliders, Bitboard occupied) {
+    const __m256i mask = _mm256_setr_epi64x(M0, M1, M2, M3);
+    __m256i gen = _mm256_set1_epi64x(sliders);
+    __m256i pro = _mm256_and_si256(_mm256_set1_epi64x(~occupied), mask);
 
-    // King offsets
-    static constexpr int KingDf[] = {-1,-1,-1, 0, 0, 1, 1, 1};
-    static constexpr int KingDr[] = {-1, 0, 1,-1, 1,-1, 0, 1};
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift_lanes<S0, S1, S2, S3>(gen)));
+    pro = _mm256_and_si256(pro, shift_lanes<S0, S1, S2, S3>(pro));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift_lanes<2*S0, 2*S1, 2*S2, 2*S3>(gen)));
+    pro = _mm256_and_si256(pro, shift_lanes<2*S0, 2*S1, 2*S2, 2*S3>(pro));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, shift_lanes<4*S0, 4*S1, 4*S2, 4*S3>(gen)));
+    __m256i attacks = _mm256_and_si256(shift_lanes<S0, S1, S2, S3>(gen), mask);
+
+    // Horizontal OR of the four lanes
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+    return Bitboard(_mm_cvtsi128_si64(half) | _mm_extract_epi64(half, 1));
+}
+
+__attribute__((target("avx2")))
+static Bitboard avx2_bishop_attacks_set(Bitboard bishops, Bitboard occupied) {
+    return fill_attacks_avx2<9, 7, -7, -9, NotFileA, NotFileH, NotFileA, NotFileH>(bishops, occupied);
+}
+
+__attribute__((target("avx2")))
+static Bitboard avx2_rook_attacks_set(Bitboard rooks, Bitboard occupied) {
+    return fill_attacks_avx2<8, -8, 1, -1, AllSquares, AllSquares, NotFileA, NotFileH>(rooks, occupied);
+}
+
+__attribute__((target("avx2")))
+static Bitboard avx2_queen_attacks_set(Bitboard queens, Bitboard occupied) {
+    return avx2_bishop_attacks_set(queens, occupied) | avx2_rook_attacks_set(queens, occupied);
+}
+#endif
+
+// The fallback is instantiated for the active backend, so it too never
+// tests it per lookup
+template<SliderBackend B>
+static constexpr SetwiseDispatch LoopSetwise = {
+    loop_bishop_attacks_set<B>, loop_rook_attacks_set<B>, loop_queen_attacks_set<B>
+};
+
+SetwiseDispatch SetwiseSliders = LoopSetwise<SliderBackend::MAGIC>;
+static bool SetwiseAvx2 = false;
+
+bool setwise_uses_avx2() { return SetwiseAvx2; }
+
+const char* slider_backend_name(SliderBackend backend) {
+    switch (backend) {
+        case SliderBackend::MAGIC: return "magic";
+        case SliderBackend::PEXT:  return "pext";
+    }
+    return "unknown";
+}
+
+static void init_magics(Magic magics[], Bitboard table[],
+                        const Bitboard magic_numbers[], int first_dir) {
+    Bitboard* slice = table;
 
     for (int sq = 0; sq < 64; ++sq) {
         Square s = Square(sq);
-        int f = file_of(s), r = rank_of(s);
-
-        // Pawn attacks
-        if (r < 7) {
-            if (f > 0) PawnAttacks[WHITE][sq] |= square_bb(make_square(f-1, r+1));
-            if (f < 7) PawnAttacks[WHITE][sq] |= square_bb(make_square(f+1, r+1));
-        }
-        if (r > 0) {
-            if (f > 0) PawnAttacks[BLACK][sq] |= square_bb(make_square(f-1, r-1));
-            if (f < 7) PawnAttacks[BLACK][sq] |= square_bb(make_square(f+1, r-1));
-        }
-
-        // Knight attacks
-        for (int i = 0; i < 8; ++i) {
-            int nf = f + KnightDf[i], nr = r + KnightDr[i];
-            if (nf >= 0 && nf <= 7 && nr >= 0 && nr <= 7)
-                KnightAttacks[sq] |= square_bb(make_square(nf, nr));
-        }
-
-        // King attacks
-        for (int i = 0; i < 8; ++i) {
-            int kf = f + KingDf[i], kr = r + KingDr[i];
-            if (kf >= 0 && kf <= 7 && kr >= 0 && kr <= 7)
-                KingAttacks[sq] |= square_bb(make_square(kf, kr));
-        }
-
-        // Rays
-        for (int d = 0; d < 8; ++d)
-            RayTable[sq][d] = compute_ray(s, d);
+
+        // Board edges are never relevant blockers unless the slider is on them
+        Bitboard edges = ((Rank1_BB | Rank8_BB) & ~rank_bb(rank_of(s)))
+                       | ((FileA_BB | FileH_BB) & ~file_bb(file_of(s)));
+
+        Magic& m = magics[sq];
+        m.mask    = sliding_attacks(s, 0, first_dir) & ~edges;
+        m.magic   = magic_numbers[sq];
+        m.shift   = 64 - popcount(m.mask);
+        m.attacks = slice;
+
+        // Carry-Rippler walk over every subset of the mask
+        Bitboard occ = 0;
+        do {
+            Bitboard attacks = sliding_attacks(s, occ, first_dir);
+            unsigned idx = with_slider_backend([&]<SliderBackend B> { return m.index<B>(occ); });
+            assert(m.attacks[idx] == 0 || m.attacks[idx] == attacks);
+            m.attacks[idx] = attacks;
+            occ = (occ - m.mask) & m.mask;
+        } while (occ);
+
+        slice += 1ULL << popcount(m.mask);
     }
+}
 
-    // Between and Line bitboards
-    for (int s1 = 0; s1 < 64; ++s1) {
-        for (int s2 = 0; s2 < 64; ++s2) {
-            BetweenBB[s1][s2] = 0;
-            LineBB[s1][s2] = 0;
-            if (s1 == s2) continue;
-
-            for (int d = 0; d < 8; ++d) {
-                if (RayTable[s1][d] & square_bb(Square(s2))) {
-                    // s2 is on ray d from s1
-                    int opp = (d + 4) & 7;
-                    LineBB[s1][s2] = RayTable[s1][d] | RayTable[s1][opp] | square_bb(Square(s1));
-                    BetweenBB[s1][s2] = RayTable[s1][d] & RayTable[s2][opp];
-                    break;
-                }
-            }
-        }
+static void init_sliders() {
+    // Pick the backends once; the per-square tables are laid out for the
+    // chosen indexing
+#ifdef CHESTRAT_X86_DISPATCH
+    if (has_fast_pext()) {
+        ActiveSliderBackend = SliderBackend::PEXT;
+        SetwiseSliders = LoopSetwise<SliderBackend::PEXT>;
     }
+
+    if (__builtin_cpu_supports("avx2")) {
+        SetwiseSliders = { avx2_bishop_attacks_set, avx2_rook_attacks_set, avx2_queen_attacks_set };
+        SetwiseAvx2 = true;
+    }
+#endif
+
+    init_magics(BishopMagics, BishopTable, BishopMagicNumbers, 1);
+    init_magics(RookMagics, RookTable, RookMagicNumbers, 0);
+}
+
+// The slider tables stay runtime-initialized: their layout depends on the
+// backend picked through CPUID, and at ~860 KB they are well past what
+// compilers will evaluate as constexpr.
+void init() {
+    static std::once_flag once;
+    std::call_once(once, init_sliders);
 }
 
 } // namespace bb
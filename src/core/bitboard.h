@@ -1,21 +1,12 @@
 #pragma once
 
 #include "types.h"
+#include <array>
 #include <bit>
 
 namespace chess {
 namespace bb {
 
-// ── Pre-computed tables ─────────────────────────────────────────────────
-extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-extern Bitboard KnightAttacks[SQUARE_NB];
-extern Bitboard KingAttacks[SQUARE_NB];
-extern Bitboard RayTable[SQUARE_NB][8]; // 8 directions: N, NE, E, SE, S, SW, W, NW
-extern Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard LineBB[SQUARE_NB][SQUARE_NB];
-
-void init();
-
 // ── Bitboard helpers ────────────────────────────────────────────────────
 constexpr Bitboard square_bb(Square s) { return 1ULL << s; }
 
@@ -32,29 +23,248 @@ constexpr Bitboard Rank6_BB = Rank1_BB << 40;
 constexpr Bitboard Rank7_BB = Rank1_BB << 48;
 constexpr Bitboard Rank8_BB = Rank1_BB << 56;
 
+constexpr Bitboard DarkSquares = 0xAA55AA55AA55AA55ULL;
+
 constexpr Bitboard file_bb(int f) { return FileA_BB << f; }
 constexpr Bitboard rank_bb(int r) { return Rank1_BB << (r * 8); }
 
-inline int popcount(Bitboard b) { return std::popcount(b); }
+constexpr int popcount(Bitboard b) { return std::popcount(b); }
 
-inline Square lsb(Bitboard b) {
+constexpr Square lsb(Bitboard b) {
     return Square(std::countr_zero(b));
 }
 
-inline Square pop_lsb(Bitboard& b) {
+constexpr Square pop_lsb(Bitboard& b) {
     Square s = lsb(b);
     b &= b - 1;
     return s;
 }
 
-inline bool more_than_one(Bitboard b) { return b & (b - 1); }
+constexpr bool more_than_one(Bitboard b) { return b & (b - 1); }
+
+// ── Pre-computed tables ─────────────────────────────────────────────────
+// Generated at compile time, so they cost nothing at startup and can be read
+// from any thread without initialization order concerns.
+namespace detail {
+
+// Direction vectors for ray generation
+// Order: N, NE, E, SE, S, SW, W, NW
+constexpr int DirFile[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+constexpr int DirRank[8] = { 1, 1, 0,-1,-1,-1, 0, 1};
+
+constexpr bool on_board(int f, int r) { return f >= 0 && f <= 7 && r >= 0 && r <= 7; }
+
+// Squares reached by stepping (df, dr) from s once, if still on the board
+constexpr Bitboard step_bb(Square s, int df, int dr) {
+    int f = file_of(s) + df, r = rank_of(s) + dr;
+    return on_board(f, r) ? square_bb(make_square(f, r)) : 0;
+}
+
+constexpr Bitboard compute_ray(Square s, int dir) {
+    Bitboard ray = 0;
+    int f = file_of(s) + DirFile[dir];
+    int r = rank_of(s) + DirRank[dir];
+    while (on_board(f, r)) {
+        ray |= square_bb(make_square(f, r));
+        f += DirFile[dir];
+        r += DirRank[dir];
+    }
+    return ray;
+}
+
+constexpr auto make_pawn_attacks() {
+    std::array<std::array<Bitboard, SQUARE_NB>, COLOR_NB> t{};
+    for (int sq = 0; sq < 64; ++sq) {
+        t[WHITE][sq] = step_bb(Square(sq), -1, 1) | step_bb(Square(sq), 1, 1);
+        t[BLACK][sq] = step_bb(Square(sq), -1, -1) | step_bb(Square(sq), 1, -1);
+    }
+    return t;
+}
+
+constexpr auto make_step_attacks(const int (&df)[8], const int (&dr)[8]) {
+    std::array<Bitboard, SQUARE_NB> t{};
+    for (int sq = 0; sq < 64; ++sq)
+        for (int i = 0; i < 8; ++i)
+            t[sq] |= step_bb(Square(sq), df[i], dr[i]);
+    return t;
+}
+
+constexpr int KnightDf[8] = {-2,-1, 1, 2, 2, 1,-1,-2};
+constexpr int KnightDr[8] = { 1, 2, 2, 1,-1,-2,-2,-1};
+constexpr int KingDf[8]   = {-1,-1,-1, 0, 0, 1, 1, 1};
+constexpr int KingDr[8]   = {-1, 0, 1,-1, 1,-1, 0, 1};
+
+constexpr auto make_rays() {
+    std::array<std::array<Bitboard, 8>, SQUARE_NB> t{};
+    for (int sq = 0; sq < 64; ++sq)
+        for (int d = 0; d < 8; ++d)
+            t[sq][d] = compute_ray(Square(sq), d);
+    return t;
+}
+
+using SquarePairTable = std::array<std::array<Bitboard, SQUARE_NB>, SQUARE_NB>;
+
+// between = true: squares strictly between s1 and s2
+// between = false: the full line through s1 and s2, edge to edge
+constexpr SquarePairTable make_square_pairs(bool between) {
+    SquarePairTable t{};
+    for (int s1 = 0; s1 < 64; ++s1) {
+        for (int d = 0; d < 8; ++d) {
+            Bitboard ray = compute_ray(Square(s1), d);
+            int opp = (d + 4) & 7;
+            for (Bitboard b = ray; b; ) {
+                Square s2 = pop_lsb(b);
+                t[s1][s2] = between
+                    ? ray & compute_ray(s2, opp)
+                    : ray | compute_ray(Square(s1), opp) | square_bb(Square(s1));
+            }
+        }
+    }
+    return t;
+}
+
+} // namespace detail
+
+inline constexpr auto PawnAttacks   = detail::make_pawn_attacks();
+inline constexpr auto KnightAttacks = detail::make_step_attacks(detail::KnightDf, detail::KnightDr);
+inline constexpr auto KingAttacks   = detail::make_step_attacks(detail::KingDf, detail::KingDr);
+inline constexpr auto RayTable      = detail::make_rays(); // 8 directions: N, NE, E, SE, S, SW, W, NW
+inline constexpr auto BetweenBB     = detail::make_square_pairs(true);
+inline constexpr auto LineBB        = detail::make_square_pairs(false);
+
+// Sets up the slider attack tables below. Safe to call more than once and
+// from several threads; only the first call does any work.
+void init();
+
+// ── Slider attacks ──────────────────────────────────────────────────────
+// Each square owns a slice of a shared attack table, indexed by the relevant
+// blockers (ray squares minus the board edge). Two backends fill and index
+// the slices differently:
+//   MAGIC - fancy magic multiply-shift, portable
+//   PEXT  - BMI2 parallel bit extract, used only where PEXT is fast
+// bb::init() picks one through CPUID. Lookups take the backend as a
+// template parameter, and the hot paths (move generation, search, perft)
+// are compiled for both and pick an instantiation once, at their entry
+// point, so the lookups inside stay inline and never test the backend. The
+// untemplated forms test it on each call, for code off those paths.
+enum class SliderBackend { MAGIC, PEXT };
+
+// Inline asm rather than _pext_u64, which only compiles in functions built
+// for BMI2: the PEXT instantiations live in ordinary translation units and
+// only run once CPUID has found the instruction.
+inline Bitboard pext(Bitboard b, Bitboard mask) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    Bitboard r;
+    asm("pextq %2, %1, %0" : "=r"(r) : "r"(b), "rm"(mask));
+    return r;
+#else
+    // Never selected here; only lets the PEXT instantiations build
+    Bitboard r = 0;
+    for (Bitboard bit = 1; mask; mask &= mask - 1, bit <<= 1)
+        if (b & mask & (0 - mask)) r |= bit;
+    return r;
+#endif
+}
+
+struct Magic {
+    Bitboard  mask;
+    Bitboard  magic;
+    Bitboard* attacks;
+    unsigned  shift;
+
+    template<SliderBackend B>
+    unsigned index(Bitboard occupied) const {
+        if constexpr (B == SliderBackend::PEXT)
+            return unsigned(pext(occupied, mask));
+        else
+            return unsigned(((occupied & mask) * magic) >> shift);
+    }
+};
+
+extern Magic BishopMagics[SQUARE_NB];
+extern Magic RookMagics[SQUARE_NB];
+extern SliderBackend ActiveSliderBackend;
 
-// ── Slider attacks (classical ray approach) ─────────────────────────────
-Bitboard bishop_attacks(Square s, Bitboard occupied);
-Bitboard rook_attacks(Square s, Bitboard occupied);
+inline SliderBackend slider_backend() { return ActiveSliderBackend; }
+const char* slider_backend_name(SliderBackend backend);
+
+// Calls f.template operator()<B>() for the active backend. This is the one
+// backend test a hot path makes, at its entry point.
+template<typename F>
+decltype(auto) with_slider_backend(F&& f) {
+    if (slider_backend() == SliderBackend::PEXT)
+        return f.template operator()<SliderBackend::PEXT>();
+    return f.template operator()<SliderBackend::MAGIC>();
+}
+
+template<SliderBackend B>
+inline Bitboard bishop_attacks(Square s, Bitboard occupied) {
+    const Magic& m = BishopMagics[s];
+    return m.attacks[m.index<B>(occupied)];
+}
 
+template<SliderBackend B>
+inline Bitboard rook_attacks(Square s, Bitboard occupied) {
+    const Magic& m = RookMagics[s];
+    return m.attacks[m.index<B>(occupied)];
+}
+
+template<SliderBackend B>
 inline Bitboard queen_attacks(Square s, Bitboard occupied) {
-    return bishop_attacks(s, occupied) | rook_attacks(s, occupied);
+    return bishop_attacks<B>(s, occupied) | rook_attacks<B>(s, occupied);
+}
+
+inline Bitboard bishop_attacks(Square s, Bitboard occupied) {
+    return with_slider_backend([=]<SliderBackend B> { return bishop_attacks<B>(s, occupied); });
+}
+
+inline Bitboard rook_attacks(Square s, Bitboard occupied) {
+    return with_slider_backend([=]<SliderBackend B> { return rook_attacks<B>(s, occupied); });
+}
+
+inline Bitboard queen_attacks(Square s, Bitboard occupied) {
+    return with_slider_backend([=]<SliderBackend B> { return queen_attacks<B>(s, occupied); });
+}
+
+// ── Set-wise attacks ────────────────────────────────────────────────────
+// Union of the attacks of every piece in a set, for attack maps where the
+// attacking square does not matter (mobility area, king zone, threats).
+// On AVX2 CPUs sliders use Kogge-Stone occluded fills, with the four
+// directions of a bishop or rook as four 64-bit lanes of one register, so
+// the cost does not depend on how many pieces are in the set. Elsewhere
+// they fall back to one lookup per piece. bb::init() picks through CPUID.
+using SetwiseAttacksFn = Bitboard (*)(Bitboard, Bitboard);
+
+struct SetwiseDispatch {
+    SetwiseAttacksFn bishop;
+    SetwiseAttacksFn rook;
+    SetwiseAttacksFn queen;
+};
+
+extern SetwiseDispatch SetwiseSliders;
+
+bool setwise_uses_avx2();
+
+inline Bitboard bishop_attacks_set(Bitboard bishops, Bitboard occupied) {
+    return SetwiseSliders.bishop(bishops, occupied);
+}
+
+inline Bitboard rook_attacks_set(Bitboard rooks, Bitboard occupied) {
+    return SetwiseSliders.rook(rooks, occupied);
+}
+
+inline Bitboard queen_attacks_set(Bitboard queens, Bitboard occupied) {
+    return SetwiseSliders.queen(queens, occupied);
+}
+
+constexpr Bitboard knight_attacks_set(Bitboard knights) {
+    Bitboard l1 = (knights >> 1) & ~FileH_BB;
+    Bitboard l2 = (knights >> 2) & ~(FileG_BB | FileH_BB);
+    Bitboard r1 = (knights << 1) & ~FileA_BB;
+    Bitboard r2 = (knights << 2) & ~(FileA_BB | FileB_BB);
+    Bitboard h1 = l1 | r1;
+    Bitboard h2 = l2 | r2;
+    return (h1 << 16) | (h1 >> 16) | (h2 << 8) | (h2 >> 8);
 }
 
 // ── Pawn helpers ────────────────────────────────────────────────────────
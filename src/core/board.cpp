@@ -1,36 +1,13 @@
 #include "board.h"
-#include <sstream>
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 
 namespace chess {
 
-// ── Zobrist ─────────────────────────────────────────────────────────────
-namespace zobrist {
-    uint64_t PieceSquare[PIECE_NB][SQUARE_NB];
-    uint64_t Castling[16];
-    uint64_t EnPassant[8];
-    uint64_t Side;
-
-    void init() {
-        std::mt19937_64 rng(0xBEEF1234CAFE5678ULL);
-        for (int p = 0; p < PIECE_NB; ++p)
-            for (int s = 0; s < SQUARE_NB; ++s)
-                PieceSquare[p][s] = rng();
-        for (int i = 0; i < 16; ++i)
-            Castling[i] = rng();
-        for (int i = 0; i < 8; ++i)
-            EnPassant[i] = rng();
-        Side = rng();
-    }
-}
-
 // ── Board ───────────────────────────────────────────────────────────────
 Board::Board() {
-    static bool zobrist_initialized = false;
-    if (!zobrist_initialized) {
-        zobrist::init();
-        zobrist_initialized = true;
-    }
+    bb::init();
 }
 
 void Board::put_piece(Piece p, Square s) {
@@ -58,137 +35,600 @@ void Board::move_piece(Square from, Square to) {
 }
 
 void Board::compute_hash() {
-    uint64_t h = 0;
-    for (int s = 0; s < 64; ++s)
-        if (mailbox_[s] != NO_PIECE)
-            h ^= zobrist::PieceSquare[mailbox_[s]][s];
+    uint64_t h = 0, mk = 0;
+    for (Bitboard b = pieces(); b; ) {
+        Square s = bb::pop_lsb(b);
+        h ^= zobrist::PieceSquare[mailbox_[s]][s];
+    }
+    for (Color c : {WHITE, BLACK})
+        for (int pt = PAWN; pt <= KING; ++pt) {
+            Piece pc = make_piece(c, PieceType(pt));
+            for (int n = count(c, PieceType(pt)); n-- > 0; )
+                mk ^= zobrist::Material[pc][n];
+        }
     h ^= zobrist::Castling[state_->castling];
     if (state_->ep_square != SQ_NONE)
         h ^= zobrist::EnPassant[file_of(state_->ep_square)];
     if (side_ == BLACK)
         h ^= zobrist::Side;
     state_->hash = h;
+    state_->material_key = mk;
 }
 
 void Board::set_startpos() {
     set_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
 }
 
-void Board::set_fen(const std::string& fen) {
-    std::memset(by_type_, 0, sizeof(by_type_));
-    std::memset(by_color_, 0, sizeof(by_color_));
-    std::memset(mailbox_, 0, sizeof(mailbox_));
+// ── FEN ─────────────────────────────────────────────────────────────────
+namespace {
 
-    std::istringstream ss(fen);
-    std::string board_str, side_str, castling_str, ep_str;
-    int halfmove = 0, fullmove = 1;
-    ss >> board_str >> side_str >> castling_str >> ep_str >> halfmove >> fullmove;
+constexpr std::string_view PieceChars = " PNBRQK  pnbrqk";
+
+// FEN letter -> piece, NO_PIECE for anything else
+constexpr auto PieceFromChar = [] {
+    std::array<Piece, 256> t{};
+    for (size_t p = 0; p < PieceChars.size(); ++p)
+        if (PieceChars[p] != ' ') t[uint8_t(PieceChars[p])] = Piece(p);
+    return t;
+}();
+
+bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+// Cursor over the FEN text; fields are separated by runs of blanks
+struct FenReader {
+    const char* p;
+    const char* end;
 
-    // Parse board
+    std::string_view field() {
+        while (p < end && is_blank(*p)) ++p;
+        const char* start = p;
+        while (p < end && !is_blank(*p)) ++p;
+        return {start, size_t(p - start)};
+    }
+};
+
+bool parse_uint(std::string_view s, int& value) {
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    return ec == std::errc() && ptr == s.data() + s.size() && value >= 0;
+}
+
+} // namespace
+
+const char* fen_error_string(FenError e) {
+    switch (e) {
+        case FenError::NONE:              return "ok";
+        case FenError::PLACEMENT:         return "bad piece placement";
+        case FenError::SIDE_TO_MOVE:      return "bad side to move";
+        case FenError::CASTLING:          return "bad castling field";
+        case FenError::EN_PASSANT:        return "bad en passant square";
+        case FenError::CLOCKS:            return "bad move counters";
+        case FenError::KINGS:             return "each side needs exactly one king";
+        case FenError::PAWN_ON_BACK_RANK: return "pawn on the first or last rank";
+        case FenError::OPPONENT_IN_CHECK: return "side not to move is in check";
+        case FenError::PIECE_COUNT:       return "too many pieces";
+    }
+    return "unknown error";
+}
+
+// Single pass over the text into locals; set_position validates the
+// decoded position before the board is touched.
+FenError Board::set_fen(std::string_view fen) {
+    FenReader in{fen.data(), fen.data() + fen.size()};
+
+    // Piece placement
+    Piece mailbox[SQUARE_NB] = {};
     int rank = 7, file = 0;
-    for (char c : board_str) {
-        if (c == '/') { --rank; file = 0; continue; }
-        if (c >= '1' && c <= '8') { file += c - '0'; continue; }
-        Color color = (c >= 'a') ? BLACK : WHITE;
-        PieceType pt = NO_PIECE_TYPE;
-        char lower = c | 32;
-        switch (lower) {
-            case 'p': pt = PAWN; break;
-            case 'n': pt = KNIGHT; break;
-            case 'b': pt = BISHOP; break;
-            case 'r': pt = ROOK; break;
-            case 'q': pt = QUEEN; break;
-            case 'k': pt = KING; break;
+    for (char c : in.field()) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) return FenError::PLACEMENT;
+            --rank;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8) return FenError::PLACEMENT;
+        } else {
+            Piece p = PieceFromChar[uint8_t(c)];
+            if (p == NO_PIECE || file > 7) return FenError::PLACEMENT;
+            mailbox[make_square(file++, rank)] = p;
+        }
+    }
+    if (rank != 0 || file != 8) return FenError::PLACEMENT;
+
+    // Side to move
+    std::string_view side = in.field();
+    if (side != "w" && side != "b") return FenError::SIDE_TO_MOVE;
+    Color us = (side == "w") ? WHITE : BLACK;
+
+    // Castling
+    std::string_view castling_field = in.field();
+    CastlingRight castling = NO_CASTLING;
+    if (castling_field != "-") {
+        if (castling_field.empty()) return FenError::CASTLING;
+        for (char c : castling_field) {
+            CastlingRight cr = c == 'K' ? WHITE_OO  : c == 'Q' ? WHITE_OOO
+                             : c == 'k' ? BLACK_OO  : c == 'q' ? BLACK_OOO : NO_CASTLING;
+            if (cr == NO_CASTLING || (castling & cr)) return FenError::CASTLING;
+            castling |= cr;
         }
-        put_piece(make_piece(color, pt), make_square(file, rank));
-        ++file;
     }
 
-    side_ = (side_str == "b") ? BLACK : WHITE;
+    // En passant: only the text is checked here, the pawn by set_position
+    std::string_view ep_field = in.field();
+    Square ep_square = SQ_NONE;
+    if (ep_field != "-") {
+        if (ep_field.size() != 2 || ep_field[0] < 'a' || ep_field[0] > 'h')
+            return FenError::EN_PASSANT;
+        int ep_rank = (us == WHITE) ? 5 : 2;
+        if (ep_field[1] != '1' + ep_rank) return FenError::EN_PASSANT;
+        ep_square = make_square(ep_field[0] - 'a', ep_rank);
+    }
+
+    // Move counters are optional, as in EPD
+    int halfmove = 0, fullmove = 1;
+    std::string_view halfmove_field = in.field();
+    std::string_view fullmove_field = in.field();
+    if (!halfmove_field.empty() && !parse_uint(halfmove_field, halfmove))
+        return FenError::CLOCKS;
+    if (!fullmove_field.empty() && !parse_uint(fullmove_field, fullmove))
+        return FenError::CLOCKS;
+    if (!in.field().empty()) return FenError::CLOCKS;
+
+    return set_position(mailbox, us, castling, ep_square, halfmove, fullmove);
+}
+
+// Shared by set_fen and unpack, so both accept exactly the same positions
+FenError Board::set_position(const Piece* mailbox, Color us, CastlingRight castling,
+                             Square ep_square, int halfmove, int fullmove) {
+    Bitboard by_type[PIECE_TYPE_NB] = {};
+    Bitboard by_color[COLOR_NB] = {};
+    for (int sq = 0; sq < 64; ++sq)
+        if (Piece p = mailbox[sq]; p != NO_PIECE) {
+            by_type[piece_type(p)] |= bb::square_bb(Square(sq));
+            by_color[piece_color(p)] |= bb::square_bb(Square(sq));
+        }
+
+    if (bb::popcount(by_color[WHITE] & by_type[KING]) != 1
+        || bb::popcount(by_color[BLACK] & by_type[KING]) != 1)
+        return FenError::KINGS;
+    if (by_type[PAWN] & (bb::Rank1_BB | bb::Rank8_BB))
+        return FenError::PAWN_ON_BACK_RANK;
+
+    // No more than promotions can make; the material key has 16 slots per
+    // piece, so these bounds also keep its indices in range
+    for (Color c : {WHITE, BLACK}) {
+        if (bb::popcount(by_color[c]) > 16 || bb::popcount(by_color[c] & by_type[PAWN]) > 8)
+            return FenError::PIECE_COUNT;
+        for (PieceType pt : {KNIGHT, BISHOP, ROOK, QUEEN})
+            if (bb::popcount(by_color[c] & by_type[pt]) > 10)
+                return FenError::PIECE_COUNT;
+    }
+
+    // Rights whose king and rook are not on their home squares are dropped,
+    // since move generation assumes both are there.
+    struct { CastlingRight cr; Square king, rook; Piece k, r; } homes[] = {
+        {WHITE_OO,  SQ_E1, SQ_H1, W_KING, W_ROOK}, {WHITE_OOO, SQ_E1, SQ_A1, W_KING, W_ROOK},
+        {BLACK_OO,  SQ_E8, SQ_H8, B_KING, B_ROOK}, {BLACK_OOO, SQ_E8, SQ_A8, B_KING, B_ROOK},
+    };
+    for (const auto& h : homes)
+        if (mailbox[h.king] != h.k || mailbox[h.rook] != h.r)
+            castling &= ~h.cr;
+
+    // En passant: the square the pawn skipped, with that pawn just beyond it
+    if (ep_square != SQ_NONE) {
+        Direction up = (us == WHITE) ? NORTH : SOUTH;
+        if (rank_of(ep_square) != (us == WHITE ? 5 : 2)
+            || mailbox[ep_square] != NO_PIECE
+            || mailbox[ep_square + up] != NO_PIECE
+            || mailbox[ep_square - up] != make_piece(~us, PAWN))
+            return FenError::EN_PASSANT;
+    }
+
+    // The side that just moved cannot have left its king in check
+    Square ksq = bb::lsb(by_color[~us] & by_type[KING]);
+    Bitboard occ = by_color[WHITE] | by_color[BLACK];
+    Bitboard attackers = (bb::PawnAttacks[~us][ksq] & by_type[PAWN])
+                       | (bb::KnightAttacks[ksq] & by_type[KNIGHT])
+                       | (bb::bishop_attacks(ksq, occ) & (by_type[BISHOP] | by_type[QUEEN]))
+                       | (bb::rook_attacks(ksq, occ) & (by_type[ROOK] | by_type[QUEEN]))
+                       | (bb::KingAttacks[ksq] & by_type[KING]);
+    if (attackers & by_color[us]) return FenError::OPPONENT_IN_CHECK;
+
+    fullmove = std::max(fullmove, 1);
+    std::memcpy(mailbox_, mailbox, sizeof(mailbox_));
+    std::memcpy(by_type_, by_type, sizeof(by_type_));
+    std::memcpy(by_color_, by_color, sizeof(by_color_));
+    side_ = us;
     fullmove_ = fullmove;
+    game_ply_ = 2 * (fullmove - 1) + (us == BLACK ? 1 : 0);
 
     // Must have a StateInfo set before calling compute_hash
-    // Caller should provide one, but we initialize fields here
     if (state_) {
-        state_->castling = NO_CASTLING;
-        for (char c : castling_str) {
-            switch (c) {
-                case 'K': state_->castling |= WHITE_OO; break;
-                case 'Q': state_->castling |= WHITE_OOO; break;
-                case 'k': state_->castling |= BLACK_OO; break;
-                case 'q': state_->castling |= BLACK_OOO; break;
-            }
-        }
-        state_->ep_square = (ep_str != "-") ? string_to_square(ep_str) : SQ_NONE;
+        state_->previous = nullptr;
+        state_->castling = castling;
+        state_->ep_square = ep_square;
         state_->halfmove_clock = halfmove;
         state_->captured = NO_PIECE;
         state_->plies_from_null = 0;
+        state_->repetition = 0;
         compute_hash();
+        bb::with_slider_backend([this]<bb::SliderBackend B> { set_check_info<B>(); });
     }
-
-    game_ply_ = 2 * (fullmove - 1) + (side_ == BLACK ? 1 : 0);
+    return FenError::NONE;
 }
 
-std::string Board::to_fen() const {
-    std::string fen;
+size_t Board::write_fen(char* out) const {
+    char* p = out;
     for (int rank = 7; rank >= 0; --rank) {
         int empty = 0;
         for (int file = 0; file < 8; ++file) {
-            Piece p = mailbox_[make_square(file, rank)];
-            if (p == NO_PIECE) { ++empty; continue; }
-            if (empty) { fen += char('0' + empty); empty = 0; }
-            const char chars[] = " PNBRQK  pnbrqk";
-            fen += chars[p];
+            Piece pc = mailbox_[make_square(file, rank)];
+            if (pc == NO_PIECE) { ++empty; continue; }
+            if (empty) { *p++ = char('0' + empty); empty = 0; }
+            *p++ = PieceChars[pc];
         }
-        if (empty) fen += char('0' + empty);
-        if (rank > 0) fen += '/';
-    }
-    fen += (side_ == WHITE) ? " w " : " b ";
-
-    std::string castling;
-    if (state_->castling & WHITE_OO)  castling += 'K';
-    if (state_->castling & WHITE_OOO) castling += 'Q';
-    if (state_->castling & BLACK_OO)  castling += 'k';
-    if (state_->castling & BLACK_OOO) castling += 'q';
-    fen += castling.empty() ? "-" : castling;
-
-    fen += ' ';
-    fen += (state_->ep_square != SQ_NONE) ? square_to_string(state_->ep_square) : "-";
-    fen += ' ' + std::to_string(state_->halfmove_clock);
-    fen += ' ' + std::to_string(fullmove_);
-    return fen;
+        if (empty) *p++ = char('0' + empty);
+        if (rank > 0) *p++ = '/';
+    }
+    *p++ = ' ';
+    *p++ = (side_ == WHITE) ? 'w' : 'b';
+    *p++ = ' ';
+
+    CastlingRight cr = state_->castling;
+    if (cr & WHITE_OO)  *p++ = 'K';
+    if (cr & WHITE_OOO) *p++ = 'Q';
+    if (cr & BLACK_OO)  *p++ = 'k';
+    if (cr & BLACK_OOO) *p++ = 'q';
+    if (!cr) *p++ = '-';
+    *p++ = ' ';
+
+    if (state_->ep_square != SQ_NONE) {
+        *p++ = char('a' + file_of(state_->ep_square));
+        *p++ = char('1' + rank_of(state_->ep_square));
+    } else {
+        *p++ = '-';
+    }
+    *p++ = ' ';
+    p = std::to_chars(p, out + MAX_FEN_LENGTH, state_->halfmove_clock).ptr;
+    *p++ = ' ';
+    p = std::to_chars(p, out + MAX_FEN_LENGTH, fullmove_).ptr;
+    return size_t(p - out);
 }
 
+std::string Board::to_fen() const {
+    char buf[MAX_FEN_LENGTH];
+    return std::string(buf, write_fen(buf));
+}
+
+template<bb::SliderBackend B>
 bool Board::is_square_attacked(Square s, Color by) const {
     if (bb::PawnAttacks[~by][s] & pieces(by, PAWN)) return true;
     if (bb::KnightAttacks[s] & pieces(by, KNIGHT)) return true;
     if (bb::KingAttacks[s] & pieces(by, KING)) return true;
     Bitboard occ = pieces();
-    if (bb::bishop_attacks(s, occ) & pieces(by, BISHOP, QUEEN)) return true;
-    if (bb::rook_attacks(s, occ) & pieces(by, ROOK, QUEEN)) return true;
+    if (bb::bishop_attacks<B>(s, occ) & pieces(by, BISHOP, QUEEN)) return true;
+    if (bb::rook_attacks<B>(s, occ) & pieces(by, ROOK, QUEEN)) return true;
     return false;
 }
 
+template<bb::SliderBackend B>
 Bitboard Board::attackers_to(Square s, Bitboard occupied) const {
     return (bb::PawnAttacks[BLACK][s] & pieces(WHITE, PAWN))
          | (bb::PawnAttacks[WHITE][s] & pieces(BLACK, PAWN))
          | (bb::KnightAttacks[s]     & pieces(KNIGHT))
-         | (bb::bishop_attacks(s, occupied) & pieces(BISHOP, QUEEN))
-         | (bb::rook_attacks(s, occupied)   & pieces(ROOK, QUEEN))
+         | (bb::bishop_attacks<B>(s, occupied) & pieces(BISHOP, QUEEN))
+         | (bb::rook_attacks<B>(s, occupied)   & pieces(ROOK, QUEEN))
          | (bb::KingAttacks[s]       & pieces(KING));
 }
 
-Bitboard Board::checkers() const {
-    return attackers_to(king_square(side_), pieces()) & pieces(~side_);
+// Pieces (of either color) that are the only piece between square s and a
+// slider in `sliders` attacking along that line. Sliders behind a blocker
+// of s's own color are returned in pinners.
+template<bb::SliderBackend B>
+Bitboard Board::slider_blockers(Bitboard sliders, Square s, Bitboard& pinners) const {
+    Bitboard blockers = 0;
+    pinners = 0;
+
+    Bitboard snipers = ((bb::rook_attacks<B>(s, 0) & pieces(ROOK, QUEEN))
+                      | (bb::bishop_attacks<B>(s, 0) & pieces(BISHOP, QUEEN))) & sliders;
+    Bitboard occ = pieces() ^ snipers;
+
+    while (snipers) {
+        Square sniper = bb::pop_lsb(snipers);
+        Bitboard between = bb::BetweenBB[s][sniper] & occ;
+        if (between && !bb::more_than_one(between)) {
+            blockers |= between;
+            if (between & pieces(piece_color(mailbox_[s])))
+                pinners |= bb::square_bb(sniper);
+        }
+    }
+    return blockers;
+}
+
+template<bb::SliderBackend B>
+void Board::set_check_info() {
+    StateInfo* st = state_;
+    Color us = side_;
+    Color them = ~us;
+
+    st->checkers = attackers_to<B>(king_square(us), pieces()) & pieces(them);
+    st->blockers_for_king[WHITE] = slider_blockers<B>(pieces(BLACK), king_square(WHITE), st->pinners[BLACK]);
+    st->blockers_for_king[BLACK] = slider_blockers<B>(pieces(WHITE), king_square(BLACK), st->pinners[WHITE]);
+
+    Square ksq = king_square(them);
+    Bitboard occ = pieces();
+    st->check_squares[NO_PIECE_TYPE] = 0;
+    st->check_squares[PAWN]   = bb::PawnAttacks[them][ksq];
+    st->check_squares[KNIGHT] = bb::KnightAttacks[ksq];
+    st->check_squares[BISHOP] = bb::bishop_attacks<B>(ksq, occ);
+    st->check_squares[ROOK]   = bb::rook_attacks<B>(ksq, occ);
+    st->check_squares[QUEEN]  = st->check_squares[BISHOP] | st->check_squares[ROOK];
+    st->check_squares[KING]   = 0;
+}
+
+template<bb::SliderBackend B>
+bool Board::gives_check(Move m) const {
+    Color us = side_;
+    Square from = m.from();
+    Square to   = m.to();
+    Square ksq  = king_square(~us);
+    MoveFlag flag = m.flags();
+
+    // Direct check
+    if (check_squares(piece_type(mailbox_[from])) & bb::square_bb(to)) return true;
+
+    // Discovered check: a blocker of our slider steps off the line
+    if ((blockers_for_king(~us) & bb::square_bb(from))
+        && !(bb::LineBB[from][to] & bb::square_bb(ksq)))
+        return true;
+
+    if (chess::is_promotion(flag)) {
+        Bitboard occ = pieces() ^ bb::square_bb(from);
+        switch (promo_piece_type(flag)) {
+            case KNIGHT: return bb::KnightAttacks[to] & bb::square_bb(ksq);
+            case BISHOP: return bb::bishop_attacks<B>(to, occ) & bb::square_bb(ksq);
+            case ROOK:   return bb::rook_attacks<B>(to, occ) & bb::square_bb(ksq);
+            default:     return bb::queen_attacks<B>(to, occ) & bb::square_bb(ksq);
+        }
+    }
+
+    // The captured pawn leaves the board too, which can open a line
+    if (flag == EP_CAPTURE) {
+        Square cap_sq = make_square(file_of(to), rank_of(from));
+        Bitboard occ = (pieces() ^ bb::square_bb(from) ^ bb::square_bb(cap_sq)) | bb::square_bb(to);
+        return (bb::rook_attacks<B>(ksq, occ) & pieces(us, ROOK, QUEEN))
+             | (bb::bishop_attacks<B>(ksq, occ) & pieces(us, BISHOP, QUEEN));
+    }
+
+    // Castling: only the rook can give check, from its new square
+    if (flag == KING_CASTLE || flag == QUEEN_CASTLE) {
+        bool king_side = (flag == KING_CASTLE);
+        Square rook_from = king_side ? to + EAST : to + WEST + WEST;
+        Square rook_to   = king_side ? to + WEST : to + EAST;
+        Bitboard occ = (pieces() ^ bb::square_bb(from) ^ bb::square_bb(rook_from))
+                     | bb::square_bb(to) | bb::square_bb(rook_to);
+        return bb::rook_attacks<B>(rook_to, occ) & bb::square_bb(ksq);
+    }
+
+    return false;
+}
+
+// Mirrors the hash updates in make_move
+uint64_t Board::key_after(Move m) const {
+    Square from = m.from(), to = m.to();
+    MoveFlag flag = m.flags();
+    Piece moving = mailbox_[from];
+    Color us = side_;
+
+    uint64_t k = state_->hash ^ zobrist::Side;
+    if (state_->ep_square != SQ_NONE)
+        k ^= zobrist::EnPassant[file_of(state_->ep_square)];
+
+    if (flag == EP_CAPTURE) {
+        Square cap_sq = (us == WHITE) ? to - NORTH : to - SOUTH;
+        k ^= zobrist::PieceSquare[mailbox_[cap_sq]][cap_sq];
+    } else if (is_capture(flag)) {
+        k ^= zobrist::PieceSquare[mailbox_[to]][to];
+    }
+
+    Piece placed = chess::is_promotion(flag) ? make_piece(us, promo_piece_type(flag)) : moving;
+    k ^= zobrist::PieceSquare[moving][from] ^ zobrist::PieceSquare[placed][to];
+
+    if (flag == KING_CASTLE || flag == QUEEN_CASTLE) {
+        bool kingside = flag == KING_CASTLE;
+        Square rook_from = us == WHITE ? (kingside ? SQ_H1 : SQ_A1) : (kingside ? SQ_H8 : SQ_A8);
+        Square rook_to   = us == WHITE ? (kingside ? SQ_F1 : SQ_D1) : (kingside ? SQ_F8 : SQ_D8);
+        Piece rook = make_piece(us, ROOK);
+        k ^= zobrist::PieceSquare[rook][rook_from] ^ zobrist::PieceSquare[rook][rook_to];
+    }
+
+    if (flag == DOUBLE_PUSH)
+        k ^= zobrist::EnPassant[file_of(from)];
+
+    CastlingRight castling = state_->castling & ~(CastlingMask[from] | CastlingMask[to]);
+    if (castling != state_->castling)
+        k ^= zobrist::Castling[state_->castling] ^ zobrist::Castling[castling];
+    return k;
+}
+
+// Exchange values for see_ge, on the evaluation's material scale
+static constexpr int SeeValue[PIECE_TYPE_NB] = { 0, 100, 320, 330, 500, 900, 0 };
+
+template<bb::SliderBackend B>
+bool Board::see_ge(Move m, int threshold) const {
+    MoveFlag flag = m.flags();
+    if (chess::is_promotion(flag) || flag == KING_CASTLE || flag == QUEEN_CASTLE)
+        return threshold <= 0;
+
+    Square from = m.from(), to = m.to();
+    Bitboard occupied = pieces() ^ bb::square_bb(from);
+    int swap;
+    if (flag == EP_CAPTURE) {
+        occupied ^= bb::square_bb(side_ == WHITE ? to - NORTH : to - SOUTH);
+        swap = SeeValue[PAWN] - threshold;
+    } else {
+        swap = SeeValue[piece_type(mailbox_[to])] - threshold;
+    }
+    if (swap < 0) return false;
+
+    // Even if the capturer is lost at once, the threshold is still met
+    swap = SeeValue[piece_type(mailbox_[from])] - swap;
+    if (swap <= 0) return true;
+
+    // `swap` is what the side that just captured stands to lose, and `res`
+    // flips with each capture: the side that runs out of profitable
+    // recaptures first loses the exchange
+    Color stm = side_;
+    Bitboard attackers = attackers_to<B>(to, occupied);
+    Bitboard diagonal = pieces(BISHOP, QUEEN), straight = pieces(ROOK, QUEEN);
+    int res = 1;
+
+    while (true) {
+        stm = ~stm;
+        attackers &= occupied;
+        Bitboard stm_attackers = attackers & pieces(stm);
+        if (state_->pinners[~stm] & occupied)
+            stm_attackers &= ~state_->blockers_for_king[stm];
+        if (!stm_attackers) break;
+
+        res ^= 1;
+
+        // Take with the least valuable attacker, then uncover x-rays
+        Bitboard b;
+        if ((b = stm_attackers & pieces(PAWN))) {
+            if ((swap = SeeValue[PAWN] - swap) < res) break;
+            occupied ^= bb::square_bb(bb::lsb(b));
+            attackers |= bb::bishop_attacks<B>(to, occupied) & diagonal;
+        } else if ((b = stm_attackers & pieces(KNIGHT))) {
+            if ((swap = SeeValue[KNIGHT] - swap) < res) break;
+            occupied ^= bb::square_bb(bb::lsb(b));
+        } else if ((b = stm_attackers & pieces(BISHOP))) {
+            if ((swap = SeeValue[BISHOP] - swap) < res) break;
+            occupied ^= bb::square_bb(bb::lsb(b));
+            attackers |= bb::bishop_attacks<B>(to, occupied) & diagonal;
+        } else if ((b = stm_attackers & pieces(ROOK))) {
+            if ((swap = SeeValue[ROOK] - swap) < res) break;
+            occupied ^= bb::square_bb(bb::lsb(b));
+            attackers |= bb::rook_attacks<B>(to, occupied) & straight;
+        } else if ((b = stm_attackers & pieces(QUEEN))) {
+            if ((swap = SeeValue[QUEEN] - swap) < res) break;
+            occupied ^= bb::square_bb(bb::lsb(b));
+            attackers |= (bb::bishop_attacks<B>(to, occupied) & diagonal)
+                       | (bb::rook_attacks<B>(to, occupied) & straight);
+        } else {
+            // The king may only take if nothing can take back
+            return (attackers & ~pieces(stm)) ? res ^ 1 : res;
+        }
+    }
+    return bool(res);
+}
+
+template<bb::SliderBackend B>
+bool Board::pseudo_legal(Move m) const {
+    Color us = side_;
+    Square from = m.from();
+    Square to   = m.to();
+    MoveFlag flag = m.flags();
+    Piece pc = mailbox_[from];
+
+    if (from == to || pc == NO_PIECE || piece_color(pc) != us) return false;
+    if (pieces(us) & bb::square_bb(to)) return false;
+
+    PieceType pt = piece_type(pc);
+    Bitboard occ = pieces();
+
+    if (flag == KING_CASTLE || flag == QUEEN_CASTLE) {
+        bool king_side = (flag == KING_CASTLE);
+        Square home = (us == WHITE) ? SQ_E1 : SQ_E8;
+        CastlingRight right = (us == WHITE) ? (king_side ? WHITE_OO : WHITE_OOO)
+                                            : (king_side ? BLACK_OO : BLACK_OOO);
+        Square rook_from = king_side ? home + EAST + EAST + EAST : home + WEST + WEST + WEST + WEST;
+        if (pt != KING || from != home || !(state_->castling & right)) return false;
+        if (to != (king_side ? home + EAST + EAST : home + WEST + WEST)) return false;
+        if (mailbox_[rook_from] != make_piece(us, ROOK)) return false;
+        return !(bb::BetweenBB[from][rook_from] & occ);
+    }
+
+    if (flag == EP_CAPTURE)
+        return pt == PAWN && to == state_->ep_square
+            && (bb::PawnAttacks[us][from] & bb::square_bb(to));
+
+    // Flags 6 and 7 are unused
+    if (!m.is_capture() && !m.is_promotion() && flag > QUEEN_CASTLE) return false;
+
+    // The capture flag must agree with the board
+    if (m.is_capture() != bool(pieces(~us) & bb::square_bb(to))) return false;
+
+    if (pt == PAWN) {
+        if (m.is_promotion() != (relative_rank(us, to) == 7)) return false;
+        if (m.is_capture()) return bb::PawnAttacks[us][from] & bb::square_bb(to);
+
+        Direction up = (us == WHITE) ? NORTH : SOUTH;
+        if (flag == DOUBLE_PUSH)
+            return relative_rank(us, from) == 1 && to == from + up + up
+                && !(occ & (bb::square_bb(from + up) | bb::square_bb(to)));
+        return to == from + up && !(occ & bb::square_bb(to));
+    }
+
+    if (m.is_promotion() || flag == DOUBLE_PUSH) return false;
+
+    Bitboard attacks;
+    switch (pt) {
+        case KNIGHT: attacks = bb::KnightAttacks[from]; break;
+        case BISHOP: attacks = bb::bishop_attacks<B>(from, occ); break;
+        case ROOK:   attacks = bb::rook_attacks<B>(from, occ); break;
+        case QUEEN:  attacks = bb::queen_attacks<B>(from, occ); break;
+        case KING:   attacks = bb::KingAttacks[from]; break;
+        default: attacks = 0;
+    }
+    return attacks & bb::square_bb(to);
 }
 
+template<bb::SliderBackend B>
+bool Board::legal(Move m) const {
+    Color us = side_;
+    Color them = ~us;
+    Square from = m.from();
+    Square to   = m.to();
+    Square ksq  = king_square(us);
+    Bitboard occ = pieces();
+
+    if (m.flags() == KING_CASTLE || m.flags() == QUEEN_CASTLE) {
+        Square pass = (to > from) ? from + EAST : from + WEST;
+        return !is_square_attacked<B>(from, them)
+            && !is_square_attacked<B>(pass, them)
+            && !is_square_attacked<B>(to, them);
+    }
+
+    // Removing both pawns can uncover a slider on the king, so test directly
+    if (m.flags() == EP_CAPTURE) {
+        Square cap_sq = (us == WHITE) ? to - NORTH : to - SOUTH;
+        Bitboard after = (occ ^ bb::square_bb(from) ^ bb::square_bb(cap_sq)) | bb::square_bb(to);
+        return !(attackers_to<B>(ksq, after) & pieces(them) & ~bb::square_bb(cap_sq));
+    }
+
+    if (from == ksq)
+        return !(attackers_to<B>(to, occ ^ bb::square_bb(from)) & pieces(them));
+
+    Bitboard check = state_->checkers;
+    if (check) {
+        if (bb::more_than_one(check)) return false;
+        if (!((bb::BetweenBB[ksq][bb::lsb(check)] | check) & bb::square_bb(to))) return false;
+    }
+
+    return !(pinned_pieces(us) & bb::square_bb(from))
+        || (bb::LineBB[ksq][from] & bb::square_bb(to));
+}
+
+template<bb::SliderBackend B>
 void Board::make_move(Move m, StateInfo& new_si) {
     // Copy state
+    new_si.previous = state_;
     new_si.castling = state_->castling;
     new_si.halfmove_clock = state_->halfmove_clock + 1;
     new_si.ep_square = SQ_NONE;
     new_si.captured = NO_PIECE;
     new_si.hash = state_->hash;
+    new_si.material_key = state_->material_key;
     new_si.plies_from_null = state_->plies_from_null + 1;
 
     StateInfo* prev = state_;
@@ -212,9 +652,11 @@ void Board::make_move(Move m, StateInfo& new_si) {
         if (flag == EP_CAPTURE) {
             cap_sq = (us == WHITE) ? to - NORTH : to - SOUTH;
         }
-        state_->captured = mailbox_[cap_sq];
-        state_->hash ^= zobrist::PieceSquare[state_->captured][cap_sq];
+        Piece captured = mailbox_[cap_sq];
+        state_->captured = captured;
+        state_->hash ^= zobrist::PieceSquare[captured][cap_sq];
         remove_piece(cap_sq);
+        state_->material_key ^= zobrist::Material[captured][count(~us, piece_type(captured))];
         state_->halfmove_clock = 0;
     }
 
@@ -227,6 +669,8 @@ void Board::make_move(Move m, StateInfo& new_si) {
         Piece promo = make_piece(us, promo_piece_type(flag));
         put_piece(promo, to);
         state_->hash ^= zobrist::PieceSquare[promo][to];
+        state_->material_key ^= zobrist::Material[moving][count(us, PAWN)]
+                              ^ zobrist::Material[promo][count(us, piece_type(promo)) - 1];
         state_->halfmove_clock = 0;
     } else {
         move_piece(from, to);
@@ -268,6 +712,23 @@ void Board::make_move(Move m, StateInfo& new_si) {
 
     if (side_ == WHITE) ++fullmove_;
     ++game_ply_;
+
+    set_check_info<B>();
+
+    // Same side to move means an even distance, and nothing before the last
+    // capture, pawn move or root can match
+    state_->repetition = 0;
+    int end = std::min(state_->halfmove_clock, state_->plies_from_null);
+    if (end >= 4) {
+        const StateInfo* stp = prev->previous;
+        for (int i = 4; i <= end; i += 2) {
+            stp = stp->previous->previous;
+            if (stp->hash == state_->hash) {
+                state_->repetition = stp->repetition ? -i : i;
+                break;
+            }
+        }
+    }
 }
 
 void Board::undo_move(Move m) {
@@ -307,9 +768,151 @@ void Board::undo_move(Move m) {
         move_piece(rook_to, rook_from);
     }
 
-    // Restore previous state (caller manages StateInfo lifetime)
-    // We need to go back to the previous StateInfo - the caller should manage this
-    // For now, we don't have a prev pointer, so the Engine/caller must manage state_ reset
+    state_ = state_->previous;
+}
+
+template<bb::SliderBackend B>
+void Board::make_null_move(StateInfo& new_si) {
+    assert(!in_check());
+    new_si = *state_;
+    new_si.previous = state_;
+    new_si.captured = NO_PIECE;
+    new_si.halfmove_clock = state_->halfmove_clock + 1;
+    new_si.plies_from_null = 0;
+    new_si.repetition = 0;
+    state_ = &new_si;
+
+    if (state_->ep_square != SQ_NONE) {
+        state_->hash ^= zobrist::EnPassant[file_of(state_->ep_square)];
+        state_->ep_square = SQ_NONE;
+    }
+    side_ = ~side_;
+    state_->hash ^= zobrist::Side;
+
+    set_check_info<B>();
+}
+
+void Board::undo_null_move() {
+    side_ = ~side_;
+    state_ = state_->previous;
+}
+
+// Both backends of the templated members; the hot paths pick one
+template void Board::make_move<bb::SliderBackend::MAGIC>(Move, StateInfo&);
+template void Board::make_move<bb::SliderBackend::PEXT>(Move, StateInfo&);
+template void Board::make_null_move<bb::SliderBackend::MAGIC>(StateInfo&);
+template void Board::make_null_move<bb::SliderBackend::PEXT>(StateInfo&);
+template bool Board::is_square_attacked<bb::SliderBackend::MAGIC>(Square, Color) const;
+template bool Board::is_square_attacked<bb::SliderBackend::PEXT>(Square, Color) const;
+template Bitboard Board::attackers_to<bb::SliderBackend::MAGIC>(Square, Bitboard) const;
+template Bitboard Board::attackers_to<bb::SliderBackend::PEXT>(Square, Bitboard) const;
+template bool Board::gives_check<bb::SliderBackend::MAGIC>(Move) const;
+template bool Board::gives_check<bb::SliderBackend::PEXT>(Move) const;
+template bool Board::see_ge<bb::SliderBackend::MAGIC>(Move, int) const;
+template bool Board::see_ge<bb::SliderBackend::PEXT>(Move, int) const;
+template bool Board::pseudo_legal<bb::SliderBackend::MAGIC>(Move) const;
+template bool Board::pseudo_legal<bb::SliderBackend::PEXT>(Move) const;
+template bool Board::legal<bb::SliderBackend::MAGIC>(Move) const;
+template bool Board::legal<bb::SliderBackend::PEXT>(Move) const;
+
+// ── Repetition ──────────────────────────────────────────────────────────
+namespace {
+
+// Cuckoo table of every reversible move: the Zobrist difference a non-pawn
+// piece moving between two squares on an empty board makes (side included),
+// with its squares. Two hash functions, one slot each, so a lookup is at
+// most two probes (Marcel van Kervinck's upcoming-repetition scheme).
+constexpr int CUCKOO_SIZE = 8192;
+
+constexpr int cuckoo_h1(uint64_t key) { return int(key & (CUCKOO_SIZE - 1)); }
+constexpr int cuckoo_h2(uint64_t key) { return int((key >> 16) & (CUCKOO_SIZE - 1)); }
+
+struct CuckooTable {
+    std::array<uint64_t, CUCKOO_SIZE> keys{};
+    std::array<Square, CUCKOO_SIZE>   from{};
+    std::array<Square, CUCKOO_SIZE>   to{};
+    int count = 0;
+};
+
+constexpr Bitboard empty_board_attacks(PieceType pt, Square s) {
+    constexpr int Diagonal[4] = {1, 3, 5, 7}, Straight[4] = {0, 2, 4, 6};
+    Bitboard b = 0;
+    switch (pt) {
+        case KNIGHT: return bb::KnightAttacks[s];
+        case KING:   return bb::KingAttacks[s];
+        case BISHOP: for (int d : Diagonal) b |= bb::RayTable[s][d]; return b;
+        case ROOK:   for (int d : Straight) b |= bb::RayTable[s][d]; return b;
+        case QUEEN:  for (int d = 0; d < 8; ++d) b |= bb::RayTable[s][d]; return b;
+        default:     return 0;
+    }
+}
+
+constexpr CuckooTable make_cuckoo() {
+    CuckooTable t;
+    for (Color c : {WHITE, BLACK})
+        for (PieceType pt : {KNIGHT, BISHOP, ROOK, QUEEN, KING})
+            for (int s1 = 0; s1 < 64; ++s1)
+                for (int s2 = s1 + 1; s2 < 64; ++s2) {
+                    if (!(empty_board_attacks(pt, Square(s1)) & bb::square_bb(Square(s2))))
+                        continue;
+                    Piece pc = make_piece(c, pt);
+                    uint64_t key = zobrist::PieceSquare[pc][s1] ^ zobrist::PieceSquare[pc][s2]
+                                 ^ zobrist::Side;
+                    Square f = Square(s1), g = Square(s2);
+                    // Insert, evicting the occupant to its other slot until one is free
+                    for (int i = cuckoo_h1(key); ; ) {
+                        std::swap(t.keys[i], key);
+                        std::swap(t.from[i], f);
+                        std::swap(t.to[i], g);
+                        if (key == 0) break;
+                        i = (i == cuckoo_h1(key)) ? cuckoo_h2(key) : cuckoo_h1(key);
+                    }
+                    ++t.count;
+                }
+    return t;
+}
+
+constexpr CuckooTable Cuckoo = make_cuckoo();
+static_assert(Cuckoo.count == 3668, "every reversible move must be in the cuckoo table");
+
+} // namespace
+
+bool Board::is_repetition(int ply) const {
+    return state_->repetition && state_->repetition < ply;
+}
+
+// Looks for an earlier position, same side to move, that differs from this
+// one by a single reversible move of the side to move whose path is clear.
+// Inside the search that means the side to move can force a repetition
+// draw; at or before the root it has to be a repetition already.
+bool Board::upcoming_repetition(int ply) const {
+    int end = std::min(state_->halfmove_clock, state_->plies_from_null);
+    if (end < 3) return false;
+
+    uint64_t key = state_->hash;
+    const StateInfo* stp = state_->previous;
+    for (int i = 3; i <= end; i += 2) {
+        stp = stp->previous->previous;
+        uint64_t move_key = key ^ stp->hash;
+
+        int j = cuckoo_h1(move_key);
+        if (Cuckoo.keys[j] != move_key) {
+            j = cuckoo_h2(move_key);
+            if (Cuckoo.keys[j] != move_key) continue;
+        }
+
+        Square s1 = Cuckoo.from[j], s2 = Cuckoo.to[j];
+        if (bb::BetweenBB[s1][s2] & pieces()) continue;
+        if (ply > i) return true;
+
+        // The table holds both directions of the move, so check that the
+        // piece that would make it belongs to the side to move, and that the
+        // earlier position was itself a repetition
+        Piece pc = mailbox_[mailbox_[s1] == NO_PIECE ? s2 : s1];
+        if (piece_color(pc) != side_) continue;
+        if (stp->repetition) return true;
+    }
+    return false;
 }
 
 // Move::from_uci needs Board
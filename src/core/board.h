@@ -3,43 +3,178 @@
 #include "types.h"
 #include "bitboard.h"
 #include "move.h"
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <random>
 
 namespace chess {
 
 // ── Zobrist hashing ─────────────────────────────────────────────────────
+// Keys are generated at compile time from a fixed-seed SplitMix64 stream,
+// so they are identical across runs and need no startup initialization.
 namespace zobrist {
-    extern uint64_t PieceSquare[PIECE_NB][SQUARE_NB];
-    extern uint64_t Castling[16];
-    extern uint64_t EnPassant[8]; // file
-    extern uint64_t Side;
-    void init();
+    namespace detail {
+        struct SplitMix64 {
+            uint64_t state;
+
+            constexpr uint64_t next() {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                return z ^ (z >> 31);
+            }
+        };
+
+        template<size_t N>
+        constexpr std::array<uint64_t, N> make_keys(uint64_t seed) {
+            SplitMix64 rng{seed};
+            std::array<uint64_t, N> keys{};
+            for (auto& k : keys) k = rng.next();
+            return keys;
+        }
+
+        constexpr auto make_piece_square_keys() {
+            std::array<std::array<uint64_t, SQUARE_NB>, PIECE_NB> keys{};
+            SplitMix64 rng{0xBEEF1234CAFE5678ULL};
+            for (auto& row : keys)
+                for (auto& k : row) k = rng.next();
+            return keys;
+        }
+
+        constexpr auto make_material_keys() {
+            std::array<std::array<uint64_t, 16>, PIECE_NB> keys{};
+            SplitMix64 rng{0x3F84D5B5B5470917ULL};
+            for (auto& row : keys)
+                for (auto& k : row) k = rng.next();
+            return keys;
+        }
+    }
+
+    inline constexpr auto PieceSquare = detail::make_piece_square_keys();
+    inline constexpr auto Castling    = detail::make_keys<16>(0x1D8E4E27C47D124FULL);
+    inline constexpr auto EnPassant   = detail::make_keys<8>(0x5A3C2E9B17F0D864ULL); // file
+    inline constexpr uint64_t Side    = detail::make_keys<1>(0x6C8E9CF570932BD5ULL)[0];
+
+    // Material signature: the n-th piece of a kind contributes Material[pc][n],
+    // so the key depends only on how many of each piece are on the board.
+    // Board::set_fen caps the counts, so n stays below 16.
+    inline constexpr auto Material    = detail::make_material_keys();
 }
 
 // ── State info (for undo) ───────────────────────────────────────────────
-struct StateInfo {
+// Each position links back to the one it was reached from, so undo_move
+// can restore the board's state pointer without help from the caller.
+struct alignas(64) StateInfo {
+    StateInfo*    previous;
     CastlingRight castling;
     Square        ep_square;
     int           halfmove_clock;
     Piece         captured;
     uint64_t      hash;
+    uint64_t      material_key;
     int           plies_from_null;
+    int           repetition;   // plies back to the same position, negative if that one was a repeat too, 0 if none
+
+    // Check info, computed once per position by make_move / set_fen
+    Bitboard      checkers;                      // enemy pieces giving check
+    Bitboard      blockers_for_king[COLOR_NB];   // sole pieces between a king and an enemy slider
+    Bitboard      pinners[COLOR_NB];             // sliders of that color pinning against the enemy king
+    Bitboard      check_squares[PIECE_TYPE_NB];  // where each piece type of the mover gives check
+};
+
+// ── State stack ─────────────────────────────────────────────────────────
+// Fixed-capacity storage for a line of StateInfos, allocated once up front.
+// Slots are contiguous and cache-line aligned, push/pop only move an index,
+// and pointers into the stack stay valid for its whole lifetime.
+class StateStack {
+public:
+    explicit StateStack(size_t capacity)
+        : slots_(new StateInfo[capacity]), capacity_(capacity) {}
+
+    StateInfo& push() {
+        assert(size_ < capacity_);
+        return slots_[size_++];
+    }
+    void pop() { assert(size_ > 0); --size_; }
+    void clear() { size_ = 0; }
+
+    StateInfo& top() { return slots_[size_ - 1]; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool   full() const { return size_ == capacity_; }
+
+private:
+    std::unique_ptr<StateInfo[]> slots_;
+    size_t size_ = 0;
+    size_t capacity_;
 };
 
+// ── FEN errors ──────────────────────────────────────────────────────────
+enum class FenError : uint8_t {
+    NONE,
+    PLACEMENT,          // bad piece letter, or a rank/board of the wrong size
+    SIDE_TO_MOVE,
+    CASTLING,
+    EN_PASSANT,         // wrong rank, or no pawn that could just have double-pushed
+    CLOCKS,             // non-numeric counters, or trailing text
+    KINGS,
+    PAWN_ON_BACK_RANK,
+    OPPONENT_IN_CHECK,
+    PIECE_COUNT,        // over 16 pieces a side, 8 pawns, or 10 of another kind
+};
+
+const char* fen_error_string(FenError e);
+
+struct PackedPosition;
+
 // ── Board ───────────────────────────────────────────────────────────────
 class Board {
 public:
     Board();
 
+    // Longest FEN write_fen can produce, with room to spare
+    static constexpr size_t MAX_FEN_LENGTH = 128;
+
     void set_startpos();
-    void set_fen(const std::string& fen);
+
+    // Parses and validates without allocating. The move counters may be
+    // left off (EPD). On error the board is left unchanged. Castling rights
+    // whose king or rook is not at home are dropped rather than rejected.
+    FenError set_fen(std::string_view fen);
+
+    // Writes the FEN to out (no terminator) and returns its length
+    size_t write_fen(char* out) const;
     std::string to_fen() const;
 
-    void make_move(Move m, StateInfo& new_si);
+    // 32-byte binary form (packed.h). pack() fails only with more than 32
+    // pieces; unpack() fails on a malformed record, on a position set_fen
+    // would reject, or with no StateInfo set, and then leaves the board
+    // unchanged.
+    bool pack(PackedPosition& out) const;
+    bool unpack(const PackedPosition& in);
+
+    // Members that look up slider attacks also come as templates on the
+    // backend (bitboard.h), for the hot paths that pick it once at their
+    // entry point. The plain forms look the backend up on each call.
+    template<bb::SliderBackend B> void make_move(Move m, StateInfo& new_si);
+    void make_move(Move m, StateInfo& new_si) {
+        bb::with_slider_backend([&]<bb::SliderBackend B> { make_move<B>(m, new_si); });
+    }
     void undo_move(Move m);
 
+    // Passes the turn (null-move pruning). Clears the en passant square and
+    // restarts plies_from_null, so repetition scans stop at a null move.
+    // Not legal while in check.
+    template<bb::SliderBackend B> void make_null_move(StateInfo& new_si);
+    void make_null_move(StateInfo& new_si) {
+        bb::with_slider_backend([&]<bb::SliderBackend B> { make_null_move<B>(new_si); });
+    }
+    void undo_null_move();
+
     // Accessors
     Color     side_to_move() const { return side_; }
     Piece     piece_on(Square s) const { return mailbox_[s]; }
@@ -49,25 +184,75 @@ public:
     Bitboard  pieces(Color c, PieceType pt) const { return by_color_[c] & by_type_[pt]; }
     Bitboard  pieces(PieceType pt1, PieceType pt2) const { return by_type_[pt1] | by_type_[pt2]; }
     Bitboard  pieces(Color c, PieceType pt1, PieceType pt2) const { return by_color_[c] & (by_type_[pt1] | by_type_[pt2]); }
+    int       count(Color c, PieceType pt) const { return bb::popcount(pieces(c, pt)); }
     Square    king_square(Color c) const { return bb::lsb(pieces(c, KING)); }
 
     CastlingRight castling_rights() const { return state_->castling; }
     Square        ep_square() const { return state_->ep_square; }
     int           halfmove_clock() const { return state_->halfmove_clock; }
     uint64_t      hash() const { return state_->hash; }
+    uint64_t      material_key() const { return state_->material_key; }
     int           fullmove_number() const { return fullmove_; }
 
     // Attack queries
-    bool is_square_attacked(Square s, Color by) const;
-    bool in_check() const { return is_square_attacked(king_square(side_), ~side_); }
-    Bitboard attackers_to(Square s, Bitboard occupied) const;
+    template<bb::SliderBackend B> bool is_square_attacked(Square s, Color by) const;
+    bool is_square_attacked(Square s, Color by) const {
+        return bb::with_slider_backend([&]<bb::SliderBackend B> { return is_square_attacked<B>(s, by); });
+    }
+    bool in_check() const { return state_->checkers; }
+    template<bb::SliderBackend B> Bitboard attackers_to(Square s, Bitboard occupied) const;
+    Bitboard attackers_to(Square s, Bitboard occupied) const {
+        return bb::with_slider_backend([&]<bb::SliderBackend B> { return attackers_to<B>(s, occupied); });
+    }
 
-    // State stack management
+    // Root state; later ones are linked in by make_move
     void set_state(StateInfo* si) { state_ = si; }
     StateInfo* state() const { return state_; }
 
-    // For move generation
-    Bitboard checkers() const;
+    // For move generation (cached in StateInfo)
+    Bitboard checkers() const { return state_->checkers; }
+    Bitboard blockers_for_king(Color c) const { return state_->blockers_for_king[c]; }
+    Bitboard pinned_pieces(Color c) const { return state_->blockers_for_king[c] & pieces(c); }
+    Bitboard check_squares(PieceType pt) const { return state_->check_squares[pt]; }
+
+    // Whether m (legal) gives check, without making it
+    template<bb::SliderBackend B> bool gives_check(Move m) const;
+    bool gives_check(Move m) const {
+        return bb::with_slider_backend([&]<bb::SliderBackend B> { return gives_check<B>(m); });
+    }
+
+    // hash() after m (pseudo-legal), without making it; for prefetching
+    uint64_t key_after(Move m) const;
+
+    // Static exchange evaluation: whether the exchange sequence m starts on
+    // its destination square wins at least `threshold` (centipawns) for the
+    // side to move, both sides always recapturing with their least valuable
+    // piece. Sliders behind a capturer join in as it leaves, and pinned
+    // pieces stay out while their pinner is on the board. Castling and
+    // promotions count as an even trade.
+    template<bb::SliderBackend B> bool see_ge(Move m, int threshold = 0) const;
+    bool see_ge(Move m, int threshold = 0) const {
+        return bb::with_slider_backend([&]<bb::SliderBackend B> { return see_ge<B>(m, threshold); });
+    }
+
+    // Validation for moves that did not come from the generator (TT moves).
+    // legal() assumes the move already passed pseudo_legal().
+    template<bb::SliderBackend B> bool pseudo_legal(Move m) const;
+    bool pseudo_legal(Move m) const {
+        return bb::with_slider_backend([&]<bb::SliderBackend B> { return pseudo_legal<B>(m); });
+    }
+    template<bb::SliderBackend B> bool legal(Move m) const;
+    bool legal(Move m) const {
+        return bb::with_slider_backend([&]<bb::SliderBackend B> { return legal<B>(m); });
+    }
+
+    // Repetitions, looking back only to the last irreversible move (or the
+    // root state). is_repetition: the position occurred before within the
+    // last `ply` plies, or for the third time. upcoming_repetition: the side
+    // to move has a reversible move back to an earlier position.
+    bool is_repetition(int ply) const;
+    bool is_threefold() const { return state_->repetition < 0; }
+    bool upcoming_repetition(int ply) const;
 
     int game_ply() const { return game_ply_; }
 
@@ -76,6 +261,11 @@ private:
     void remove_piece(Square s);
     void move_piece(Square from, Square to);
     void compute_hash();
+    template<bb::SliderBackend B> void set_check_info();
+    FenError set_position(const Piece* mailbox, Color us, CastlingRight castling,
+                          Square ep_square, int halfmove, int fullmove);
+    template<bb::SliderBackend B>
+    Bitboard slider_blockers(Bitboard sliders, Square s, Bitboard& pinners) const;
 
     // Dual representation
     Bitboard  by_type_[PIECE_TYPE_NB] = {};
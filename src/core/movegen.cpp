@@ -2,259 +2,292 @@
 
 namespace chess {
 
-// ── Pseudo-legal generation helpers ─────────────────────────────────────
+// ── Legal generation ────────────────────────────────────────────────────
+// Checkers and pins are worked out once per position. Every generator then
+// emits only moves that are legal:
+//   - in check, non-king moves must capture the checker or block its ray
+//   - pinned pieces stay on the line through their king and the pinner
+//   - the king only steps to squares the enemy does not attack once the
+//     king itself is lifted off the board (so it cannot hide behind itself)
+//   - en passant gets an explicit test, since removing two pawns from one
+//     rank can expose the king to a slider no pin mask sees
+
+struct GenContext {
+    Color    us, them;
+    Square   ksq;
+    Bitboard occ;
+    Bitboard enemies;
+    Bitboard check_mask;   // capture-or-block squares; all squares if not in check
+    Bitboard pinned;
+};
+
+// Squares attacked by `them` with our king removed from the occupancy
+static Bitboard king_danger(const Board& board, const GenContext& ctx) {
+    Color them = ctx.them;
+    Bitboard occ = ctx.occ ^ bb::square_bb(ctx.ksq);
+    Bitboard pawns = board.pieces(them, PAWN);
+    Bitboard pawn_attacks = (them == WHITE) ? bb::shift_nw(pawns) | bb::shift_ne(pawns)
+                                            : bb::shift_sw(pawns) | bb::shift_se(pawns);
+    return pawn_attacks
+         | bb::knight_attacks_set(board.pieces(them, KNIGHT))
+         | bb::bishop_attacks_set(board.pieces(them, BISHOP, QUEEN), occ)
+         | bb::rook_attacks_set(board.pieces(them, ROOK, QUEEN), occ)
+         | bb::KingAttacks[board.king_square(them)];
+}
+
+static bool pin_allows(const GenContext& ctx, Square from, Square to) {
+    return !(ctx.pinned & bb::square_bb(from))
+        || (bb::LineBB[ctx.ksq][from] & bb::square_bb(to));
+}
+
+template<bb::SliderBackend B>
+static bool ep_is_legal(const Board& board, const GenContext& ctx, Square from, Square to) {
+    Square cap_sq = (ctx.us == WHITE) ? to - NORTH : to - SOUTH;
+    Bitboard occ = (ctx.occ ^ bb::square_bb(from) ^ bb::square_bb(cap_sq)) | bb::square_bb(to);
+    return !(board.attackers_to<B>(ctx.ksq, occ) & ctx.enemies & ~bb::square_bb(cap_sq));
+}
+
+static void push_pawn_moves(const GenContext& ctx, MoveList& list, Bitboard targets,
+                            Direction dir, MoveFlag flag) {
+    while (targets) {
+        Square to = bb::pop_lsb(targets);
+        Square from = to - dir;
+        if (pin_allows(ctx, from, to))
+            list.push(Move(from, to, flag));
+    }
+}
+
+// Push-promotions are split by piece: the queen counts as a "capture" (it
+// is searched in quiescence), the under-promotions as quiet moves.
+template<GenType GT>
+static void push_promotions(const GenContext& ctx, MoveList& list, Bitboard targets,
+                            Direction dir, bool capture) {
+    int base = capture ? PROMO_CAPTURE_KNIGHT : PROMO_KNIGHT;
+    bool queen = capture || GT != QUIETS_ONLY;
+    bool under = capture || GT != CAPTURES_ONLY;
+    while (targets) {
+        Square to = bb::pop_lsb(targets);
+        Square from = to - dir;
+        if (!pin_allows(ctx, from, to)) continue;
+        if (queen) list.push(Move(from, to, MoveFlag(base + 3)));
+        if (under) {
+            list.push(Move(from, to, MoveFlag(base + 0)));
+            list.push(Move(from, to, MoveFlag(base + 1)));
+            list.push(Move(from, to, MoveFlag(base + 2)));
+        }
+    }
+}
 
-static void generate_pawn_moves(const Board& board, MoveList& list, bool caps_only) {
-    Color us = board.side_to_move();
-    Color them = ~us;
+template<GenType GT, bb::SliderBackend B>
+static void generate_pawn_moves(const Board& board, const GenContext& ctx, MoveList& list) {
+    Color us = ctx.us;
     Bitboard pawns = board.pieces(us, PAWN);
-    Bitboard occ = board.pieces();
-    Bitboard enemies = board.pieces(them);
+    Bitboard empty = ~ctx.occ;
+    Bitboard enemies = ctx.enemies & ctx.check_mask;
     Square ep = board.ep_square();
 
     Direction up    = (us == WHITE) ? NORTH : SOUTH;
     Bitboard rank7  = (us == WHITE) ? bb::Rank7_BB : bb::Rank2_BB;
     Bitboard rank3  = (us == WHITE) ? bb::Rank3_BB : bb::Rank6_BB;
+    Direction left_dir  = (us == WHITE) ? NORTH_WEST : SOUTH_WEST;
+    Direction right_dir = (us == WHITE) ? NORTH_EAST : SOUTH_EAST;
+
+    auto push  = [us](Bitboard b) { return us == WHITE ? bb::shift_north(b) : bb::shift_south(b); };
+    auto left  = [us](Bitboard b) { return us == WHITE ? bb::shift_nw(b) : bb::shift_sw(b); };
+    auto right = [us](Bitboard b) { return us == WHITE ? bb::shift_ne(b) : bb::shift_se(b); };
 
     Bitboard promo_pawns = pawns & rank7;
     Bitboard non_promo   = pawns & ~rank7;
 
-    // Single push (non-promoting)
-    if (!caps_only) {
-        Bitboard single = (us == WHITE) ? bb::shift_north(non_promo) : bb::shift_south(non_promo);
-        single &= ~occ;
-        Bitboard dbl = (us == WHITE) ? bb::shift_north(single & rank3) : bb::shift_south(single & rank3);
-        dbl &= ~occ;
-
-        while (single) {
-            Square to = bb::pop_lsb(single);
-            list.push(Move(to - up, to, NORMAL));
-        }
-        while (dbl) {
-            Square to = bb::pop_lsb(dbl);
-            list.push(Move(to - up - up, to, DOUBLE_PUSH));
-        }
+    // Single and double pushes (non-promoting)
+    if (GT != CAPTURES_ONLY) {
+        Bitboard single = push(non_promo) & empty;
+        Bitboard dbl = push(single & rank3) & empty;
+        push_pawn_moves(ctx, list, single & ctx.check_mask, up, NORMAL);
+        push_pawn_moves(ctx, list, dbl & ctx.check_mask, Direction(2 * up), DOUBLE_PUSH);
     }
 
     // Captures (non-promoting)
-    {
-        Bitboard left  = (us == WHITE) ? bb::shift_nw(non_promo) : bb::shift_sw(non_promo);
-        Bitboard right = (us == WHITE) ? bb::shift_ne(non_promo) : bb::shift_se(non_promo);
-        left &= enemies;
-        right &= enemies;
-
-        Direction left_dir  = (us == WHITE) ? NORTH_WEST : SOUTH_WEST;
-        Direction right_dir = (us == WHITE) ? NORTH_EAST : SOUTH_EAST;
-
-        while (left) {
-            Square to = bb::pop_lsb(left);
-            list.push(Move(to - left_dir, to, CAPTURE));
-        }
-        while (right) {
-            Square to = bb::pop_lsb(right);
-            list.push(Move(to - right_dir, to, CAPTURE));
-        }
+    if (GT != QUIETS_ONLY) {
+        push_pawn_moves(ctx, list, left(non_promo) & enemies, left_dir, CAPTURE);
+        push_pawn_moves(ctx, list, right(non_promo) & enemies, right_dir, CAPTURE);
     }
 
     // Promotions (push + capture)
     if (promo_pawns) {
-        Bitboard push_promo = (us == WHITE) ? bb::shift_north(promo_pawns) : bb::shift_south(promo_pawns);
-        push_promo &= ~occ;
-
-        Bitboard left_promo  = (us == WHITE) ? bb::shift_nw(promo_pawns) : bb::shift_sw(promo_pawns);
-        Bitboard right_promo = (us == WHITE) ? bb::shift_ne(promo_pawns) : bb::shift_se(promo_pawns);
-        left_promo &= enemies;
-        right_promo &= enemies;
-
-        Direction left_dir  = (us == WHITE) ? NORTH_WEST : SOUTH_WEST;
-        Direction right_dir = (us == WHITE) ? NORTH_EAST : SOUTH_EAST;
-
-        while (push_promo) {
-            Square to = bb::pop_lsb(push_promo);
-            if (!caps_only) {
-                list.push(Move(to - up, to, PROMO_KNIGHT));
-                list.push(Move(to - up, to, PROMO_BISHOP));
-                list.push(Move(to - up, to, PROMO_ROOK));
-            }
-            list.push(Move(to - up, to, PROMO_QUEEN));
-        }
-        while (left_promo) {
-            Square to = bb::pop_lsb(left_promo);
-            list.push(Move(to - left_dir, to, PROMO_CAPTURE_KNIGHT));
-            list.push(Move(to - left_dir, to, PROMO_CAPTURE_BISHOP));
-            list.push(Move(to - left_dir, to, PROMO_CAPTURE_ROOK));
-            list.push(Move(to - left_dir, to, PROMO_CAPTURE_QUEEN));
-        }
-        while (right_promo) {
-            Square to = bb::pop_lsb(right_promo);
-            list.push(Move(to - right_dir, to, PROMO_CAPTURE_KNIGHT));
-            list.push(Move(to - right_dir, to, PROMO_CAPTURE_BISHOP));
-            list.push(Move(to - right_dir, to, PROMO_CAPTURE_ROOK));
-            list.push(Move(to - right_dir, to, PROMO_CAPTURE_QUEEN));
+        push_promotions<GT>(ctx, list, push(promo_pawns) & empty & ctx.check_mask, up, false);
+        if (GT != QUIETS_ONLY) {
+            push_promotions<GT>(ctx, list, left(promo_pawns) & enemies, left_dir, true);
+            push_promotions<GT>(ctx, list, right(promo_pawns) & enemies, right_dir, true);
         }
     }
 
     // En passant
-    if (ep != SQ_NONE) {
-        Bitboard ep_candidates = bb::PawnAttacks[them][ep] & pawns;
+    if (GT != QUIETS_ONLY && ep != SQ_NONE) {
+        Bitboard ep_candidates = bb::PawnAttacks[ctx.them][ep] & non_promo;
         while (ep_candidates) {
             Square from = bb::pop_lsb(ep_candidates);
-            list.push(Move(from, ep, EP_CAPTURE));
+            if (ep_is_legal<B>(board, ctx, from, ep))
+                list.push(Move(from, ep, EP_CAPTURE));
         }
     }
 }
 
-static void generate_piece_moves(const Board& board, MoveList& list, PieceType pt, bool caps_only) {
-    Color us = board.side_to_move();
-    Bitboard occ = board.pieces();
-    Bitboard targets = caps_only ? board.pieces(~us) : ~board.pieces(us);
-    Bitboard pieces = board.pieces(us, pt);
+// Destination squares allowed by the generation type
+template<GenType GT>
+static Bitboard gen_targets(const Board& board, const GenContext& ctx) {
+    switch (GT) {
+        case CAPTURES_ONLY: return ctx.enemies;
+        case QUIETS_ONLY:   return ~ctx.occ;
+        default:            return ~board.pieces(ctx.us);
+    }
+}
+
+template<GenType GT, bb::SliderBackend B>
+static void generate_piece_moves(const Board& board, const GenContext& ctx, MoveList& list,
+                                 PieceType pt) {
+    Bitboard targets = gen_targets<GT>(board, ctx) & ctx.check_mask;
+    Bitboard pieces = board.pieces(ctx.us, pt);
+
+    // A pinned knight can never move along the pin line
+    if (pt == KNIGHT) pieces &= ~ctx.pinned;
 
     while (pieces) {
         Square from = bb::pop_lsb(pieces);
         Bitboard attacks;
         switch (pt) {
             case KNIGHT: attacks = bb::KnightAttacks[from]; break;
-            case BISHOP: attacks = bb::bishop_attacks(from, occ); break;
-            case ROOK:   attacks = bb::rook_attacks(from, occ); break;
-            case QUEEN:  attacks = bb::queen_attacks(from, occ); break;
-            case KING:   attacks = bb::KingAttacks[from]; break;
+            case BISHOP: attacks = bb::bishop_attacks<B>(from, ctx.occ); break;
+            case ROOK:   attacks = bb::rook_attacks<B>(from, ctx.occ); break;
+            case QUEEN:  attacks = bb::queen_attacks<B>(from, ctx.occ); break;
             default: attacks = 0;
         }
         attacks &= targets;
+        if (ctx.pinned & bb::square_bb(from))
+            attacks &= bb::LineBB[ctx.ksq][from];
         while (attacks) {
             Square to = bb::pop_lsb(attacks);
-            MoveFlag flag = (board.piece_on(to) != NO_PIECE) ? CAPTURE : NORMAL;
+            MoveFlag flag = (ctx.enemies & bb::square_bb(to)) ? CAPTURE : NORMAL;
             list.push(Move(from, to, flag));
         }
     }
 }
 
-static void generate_castling(const Board& board, MoveList& list) {
-    Color us = board.side_to_move();
-    Bitboard occ = board.pieces();
-
-    if (us == WHITE) {
-        if ((board.castling_rights() & WHITE_OO) &&
-            !(occ & (bb::square_bb(SQ_F1) | bb::square_bb(SQ_G1))) &&
-            !board.is_square_attacked(SQ_E1, BLACK) &&
-            !board.is_square_attacked(SQ_F1, BLACK) &&
-            !board.is_square_attacked(SQ_G1, BLACK))
-        {
-            list.push(Move(SQ_E1, SQ_G1, KING_CASTLE));
-        }
-        if ((board.castling_rights() & WHITE_OOO) &&
-            !(occ & (bb::square_bb(SQ_D1) | bb::square_bb(SQ_C1) | bb::square_bb(SQ_B1))) &&
-            !board.is_square_attacked(SQ_E1, BLACK) &&
-            !board.is_square_attacked(SQ_D1, BLACK) &&
-            !board.is_square_attacked(SQ_C1, BLACK))
-        {
-            list.push(Move(SQ_E1, SQ_C1, QUEEN_CASTLE));
-        }
-    } else {
-        if ((board.castling_rights() & BLACK_OO) &&
-            !(occ & (bb::square_bb(SQ_F8) | bb::square_bb(SQ_G8))) &&
-            !board.is_square_attacked(SQ_E8, WHITE) &&
-            !board.is_square_attacked(SQ_F8, WHITE) &&
-            !board.is_square_attacked(SQ_G8, WHITE))
-        {
-            list.push(Move(SQ_E8, SQ_G8, KING_CASTLE));
-        }
-        if ((board.castling_rights() & BLACK_OOO) &&
-            !(occ & (bb::square_bb(SQ_D8) | bb::square_bb(SQ_C8) | bb::square_bb(SQ_B8))) &&
-            !board.is_square_attacked(SQ_E8, WHITE) &&
-            !board.is_square_attacked(SQ_D8, WHITE) &&
-            !board.is_square_attacked(SQ_C8, WHITE))
-        {
-            list.push(Move(SQ_E8, SQ_C8, QUEEN_CASTLE));
-        }
+template<GenType GT>
+static void generate_king_moves(const Board& board, const GenContext& ctx, MoveList& list,
+                                Bitboard danger) {
+    Bitboard targets = gen_targets<GT>(board, ctx) & ~danger;
+    Bitboard attacks = bb::KingAttacks[ctx.ksq] & targets;
+    while (attacks) {
+        Square to = bb::pop_lsb(attacks);
+        MoveFlag flag = (ctx.enemies & bb::square_bb(to)) ? CAPTURE : NORMAL;
+        list.push(Move(ctx.ksq, to, flag));
     }
 }
 
-template<GenType GT>
-void generate_moves(const Board& board, MoveList& list) {
-    bool caps_only = (GT == CAPTURES_ONLY);
-
-    generate_pawn_moves(board, list, caps_only);
-    generate_piece_moves(board, list, KNIGHT, caps_only);
-    generate_piece_moves(board, list, BISHOP, caps_only);
-    generate_piece_moves(board, list, ROOK, caps_only);
-    generate_piece_moves(board, list, QUEEN, caps_only);
-    generate_piece_moves(board, list, KING, caps_only);
-
-    if (!caps_only) {
-        generate_castling(board, list);
+// Only called when not in check
+static void generate_castling(const Board& board, const GenContext& ctx, MoveList& list,
+                              Bitboard danger) {
+    Bitboard occ = ctx.occ;
+    CastlingRight oo  = (ctx.us == WHITE) ? WHITE_OO  : BLACK_OO;
+    CastlingRight ooo = (ctx.us == WHITE) ? WHITE_OOO : BLACK_OOO;
+    Square ksq = ctx.ksq;
+
+    // King-side: f and g must be empty and safe
+    if (board.castling_rights() & oo) {
+        Bitboard path = bb::square_bb(ksq + EAST) | bb::square_bb(ksq + EAST + EAST);
+        if (!(occ & path) && !(danger & path))
+            list.push(Move(ksq, ksq + EAST + EAST, KING_CASTLE));
+    }
+    // Queen-side: b, c and d must be empty; only c and d must be safe
+    if (board.castling_rights() & ooo) {
+        Bitboard king_path = bb::square_bb(ksq + WEST) | bb::square_bb(ksq + WEST + WEST);
+        Bitboard empty_path = king_path | bb::square_bb(ksq + WEST + WEST + WEST);
+        if (!(occ & empty_path) && !(danger & king_path))
+            list.push(Move(ksq, ksq + WEST + WEST, QUEEN_CASTLE));
     }
 }
 
-// Explicit instantiations
-template void generate_moves<ALL_MOVES>(const Board& board, MoveList& list);
-template void generate_moves<CAPTURES_ONLY>(const Board& board, MoveList& list);
-
-// ── Legal move filtering ────────────────────────────────────────────────
-
-static bool is_legal(const Board& board, Move m) {
-    // Make move on a copy, check if king is in check
-    Board copy = board;
-    StateInfo si;
-    copy.set_state(&si);
-    // We need state set up - copy the current state
-    si.castling = board.castling_rights();
-    si.ep_square = board.ep_square();
-    si.halfmove_clock = board.halfmove_clock();
-    si.hash = board.hash();
-    si.captured = NO_PIECE;
-    si.plies_from_null = 0;
-
-    StateInfo new_si;
-    copy.make_move(m, new_si);
-    // After make_move, side has flipped; check if the moving side's king is attacked
-    Color moved = ~copy.side_to_move();
-    return !copy.is_square_attacked(copy.king_square(moved), copy.side_to_move());
+template<GenType GT, bb::SliderBackend B>
+void generate_legal(const Board& board, MoveList& list) {
+    GenContext ctx;
+    ctx.us      = board.side_to_move();
+    ctx.them    = ~ctx.us;
+    ctx.ksq     = board.king_square(ctx.us);
+    ctx.occ     = board.pieces();
+    ctx.enemies = board.pieces(ctx.them);
+    ctx.pinned  = board.pinned_pieces(ctx.us);
+
+    Bitboard checkers = board.checkers();
+    Bitboard danger = king_danger(board, ctx);
+
+    // Double check: only the king can move
+    if (bb::more_than_one(checkers)) {
+        generate_king_moves<GT>(board, ctx, list, danger);
+        return;
+    }
+
+    ctx.check_mask = checkers
+        ? bb::BetweenBB[ctx.ksq][bb::lsb(checkers)] | checkers
+        : ~Bitboard(0);
+
+    generate_pawn_moves<GT, B>(board, ctx, list);
+    generate_piece_moves<GT, B>(board, ctx, list, KNIGHT);
+    generate_piece_moves<GT, B>(board, ctx, list, BISHOP);
+    generate_piece_moves<GT, B>(board, ctx, list, ROOK);
+    generate_piece_moves<GT, B>(board, ctx, list, QUEEN);
+    generate_king_moves<GT>(board, ctx, list, danger);
+
+    if (GT != CAPTURES_ONLY && !checkers) {
+        generate_castling(board, ctx, list, danger);
+    }
 }
 
+// Explicit instantiations
+template void generate_legal<ALL_MOVES, bb::SliderBackend::MAGIC>(const Board& board, MoveList& list);
+template void generate_legal<ALL_MOVES, bb::SliderBackend::PEXT>(const Board& board, MoveList& list);
+template void generate_legal<CAPTURES_ONLY, bb::SliderBackend::MAGIC>(const Board& board, MoveList& list);
+template void generate_legal<CAPTURES_ONLY, bb::SliderBackend::PEXT>(const Board& board, MoveList& list);
+template void generate_legal<QUIETS_ONLY, bb::SliderBackend::MAGIC>(const Board& board, MoveList& list);
+template void generate_legal<QUIETS_ONLY, bb::SliderBackend::PEXT>(const Board& board, MoveList& list);
+
 void generate_legal_moves(const Board& board, MoveList& list) {
-    MoveList pseudo;
-    generate_moves<ALL_MOVES>(board, pseudo);
-    for (int i = 0; i < pseudo.count; ++i) {
-        if (is_legal(board, pseudo.moves[i]))
-            list.push(pseudo.moves[i]);
-    }
+    bb::with_slider_backend([&]<bb::SliderBackend B> { generate_legal<ALL_MOVES, B>(board, list); });
 }
 
 void generate_legal_captures(const Board& board, MoveList& list) {
-    MoveList pseudo;
-    generate_moves<CAPTURES_ONLY>(board, pseudo);
-    for (int i = 0; i < pseudo.count; ++i) {
-        if (is_legal(board, pseudo.moves[i]))
-            list.push(pseudo.moves[i]);
-    }
+    bb::with_slider_backend([&]<bb::SliderBackend B> { generate_legal<CAPTURES_ONLY, B>(board, list); });
 }
 
 // ── Perft ───────────────────────────────────────────────────────────────
 
-uint64_t perft(Board& board, int depth, std::vector<StateInfo>& states) {
+template<bb::SliderBackend B>
+uint64_t perft(Board& board, int depth, StateStack& states) {
     if (depth == 0) return 1;
 
     MoveList moves;
-    generate_legal_moves(board, moves);
+    generate_legal<ALL_MOVES, B>(board, moves);
 
     if (depth == 1) return moves.count;
 
     uint64_t nodes = 0;
-    StateInfo* prev_state = board.state();
-    size_t state_idx = states.size();
-    states.emplace_back();
+    StateInfo& st = states.push();
 
     for (int i = 0; i < moves.count; ++i) {
-        board.make_move(moves.moves[i], states[state_idx]);
-        nodes += perft(board, depth - 1, states);
+        board.make_move<B>(moves.moves[i], st);
+        nodes += perft<B>(board, depth - 1, states);
         board.undo_move(moves.moves[i]);
-        board.set_state(prev_state);
     }
 
-    states.pop_back();
+    states.pop();
     return nodes;
 }
 
+template uint64_t perft<bb::SliderBackend::MAGIC>(Board& board, int depth, StateStack& states);
+template uint64_t perft<bb::SliderBackend::PEXT>(Board& board, int depth, StateStack& states);
+
+uint64_t perft(Board& board, int depth, StateStack& states) {
+    return bb::with_slider_backend([&]<bb::SliderBackend B> { return perft<B>(board, depth, states); });
+}
+
 } // namespace chess
@@ -2,11 +2,10 @@
 
 #include "board.h"
 #include "move.h"
-#include <vector>
 
 namespace chess {
 
-enum GenType { ALL_MOVES, CAPTURES_ONLY };
+enum GenType { ALL_MOVES, CAPTURES_ONLY, QUIETS_ONLY };
 
 struct MoveList {
     Move moves[256];
@@ -20,14 +19,20 @@ struct MoveList {
     int size() const { return count; }
 };
 
-template<GenType GT>
-void generate_moves(const Board& board, MoveList& list);
+// Legal move generation. Pins and checks are resolved during generation,
+// so every move produced is legal; no make/unmake filtering is needed.
+// CAPTURES_ONLY yields captures, en passant and queen push-promotions;
+// QUIETS_ONLY yields everything else, so the two together equal ALL_MOVES.
+// B is the slider backend (bitboard.h); the plain wrappers below look it up.
+template<GenType GT, bb::SliderBackend B>
+void generate_legal(const Board& board, MoveList& list);
 
-// Legal move generation (filters out moves leaving king in check)
 void generate_legal_moves(const Board& board, MoveList& list);
 void generate_legal_captures(const Board& board, MoveList& list);
 
-// Perft
-uint64_t perft(Board& board, int depth, std::vector<StateInfo>& states);
+// Perft. `states` needs a free slot per ply of depth.
+template<bb::SliderBackend B>
+uint64_t perft(Board& board, int depth, StateStack& states);
+uint64_t perft(Board& board, int depth, StateStack& states);
 
 } // namespace chess
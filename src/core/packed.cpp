@@ -0,0 +1,80 @@
+#include "packed.h"
+#include <algorithm>
+#include <cstring>
+
+namespace chess {
+
+namespace {
+
+constexpr int NO_EP_FILE = 8;
+
+// Valid 4-bit codes are exactly the Piece values
+constexpr bool valid_piece_code(unsigned code) {
+    unsigned pt = code & 7;
+    return pt >= PAWN && pt <= KING;
+}
+
+void store_le(uint8_t* p, uint64_t v, int n) {
+    for (int i = 0; i < n; ++i) p[i] = uint8_t(v >> (8 * i));
+}
+
+uint64_t load_le(const uint8_t* p, int n) {
+    uint64_t v = 0;
+    for (int i = 0; i < n; ++i) v |= uint64_t(p[i]) << (8 * i);
+    return v;
+}
+
+} // namespace
+
+bool Board::pack(PackedPosition& out) const {
+    std::memset(out.bytes, 0, sizeof(out.bytes));
+
+    Bitboard occ = pieces();
+    if (bb::popcount(occ) > 32) return false;
+    store_le(out.bytes, occ, 8);
+
+    int i = 0;
+    for (Bitboard b = occ; b; ++i) {
+        Square s = bb::pop_lsb(b);
+        out.bytes[8 + i / 2] |= uint8_t(mailbox_[s] << (4 * (i & 1)));
+    }
+
+    out.bytes[24] = uint8_t(state_->castling | (side_ << 4));
+    out.bytes[25] = uint8_t(state_->ep_square != SQ_NONE ? file_of(state_->ep_square) : NO_EP_FILE);
+    out.bytes[26] = uint8_t(std::min(state_->halfmove_clock, 255));
+    store_le(out.bytes + 27, uint64_t(std::clamp(fullmove_, 1, 65535)), 2);
+    return true;
+}
+
+// Decodes into locals first, like set_fen, so a bad record changes nothing
+bool Board::unpack(const PackedPosition& in) {
+    if (!state_) return false;
+
+    Bitboard occ = load_le(in.bytes, 8);
+    if (bb::popcount(occ) > 32) return false;
+
+    Piece mailbox[SQUARE_NB] = {};
+    int i = 0;
+    for (Bitboard b = occ; b; ++i) {
+        Square s = bb::pop_lsb(b);
+        unsigned code = (in.bytes[8 + i / 2] >> (4 * (i & 1))) & 0xF;
+        if (!valid_piece_code(code)) return false;
+        mailbox[s] = Piece(code);
+    }
+
+    Color us = Color((in.bytes[24] >> 4) & 1);
+    int ep_file = in.bytes[25];
+    if (ep_file > NO_EP_FILE) return false;
+    Square ep_square = ep_file == NO_EP_FILE ? SQ_NONE
+                                             : make_square(ep_file, us == WHITE ? 5 : 2);
+
+    return set_position(mailbox, us, CastlingRight(in.bytes[24] & 0xF), ep_square,
+                        in.bytes[26], int(load_le(in.bytes + 27, 2))) == FenError::NONE;
+}
+
+void pack_positions(const Board* boards, size_t n, PackedPosition* out) {
+    for (size_t i = 0; i < n; ++i)
+        boards[i].pack(out[i]);
+}
+
+} // namespace chess
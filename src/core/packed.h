@@ -0,0 +1,49 @@
+#pragma once
+
+#include "board.h"
+#include <cstdint>
+
+namespace chess {
+
+// ── Packed positions ────────────────────────────────────────────────────
+// A position in 32 bytes, for position stores and pipes between processes.
+// The layout is fixed and little-endian, so records can be written to disk
+// or a socket as raw bytes:
+//
+//   0..7    occupancy bitboard
+//   8..23   4-bit Piece code of each occupied square, lowest square first,
+//           low nibble first (a legal position has at most 32 pieces)
+//   24      castling rights (bits 0-3), side to move (bit 4)
+//   25      en passant file, 8 if none
+//   26      halfmove clock, saturated at 255
+//   27..28  fullmove number, saturated at 65535
+//   29..31  zero
+struct PackedPosition {
+    uint8_t bytes[32];
+
+    bool operator==(const PackedPosition& o) const {
+        for (int i = 0; i < 32; ++i)
+            if (bytes[i] != o.bytes[i]) return false;
+        return true;
+    }
+};
+
+static_assert(sizeof(PackedPosition) == 32);
+
+// Encodes n boards into out[0..n). Boards with more than 32 pieces cannot
+// be packed; their records are left zeroed.
+void pack_positions(const Board* boards, size_t n, PackedPosition* out);
+
+// Decodes in[0..n) one after another onto `board` and calls f(board, i)
+// after each. Stops at the first invalid record and returns how many were
+// decoded.
+template<typename F>
+size_t unpack_positions(const PackedPosition* in, size_t n, Board& board, F&& f) {
+    for (size_t i = 0; i < n; ++i) {
+        if (!board.unpack(in[i])) return i;
+        f(board, i);
+    }
+    return n;
+}
+
+} // namespace chess
@@ -0,0 +1,178 @@
+#include "san.h"
+#include "movegen.h"
+
+namespace chess {
+
+namespace {
+
+constexpr char PieceLetters[] = " PNBRQK";
+
+PieceType piece_from_letter(char c) {
+    switch (c) {
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+        case 'K': return KING;
+        default:  return NO_PIECE_TYPE;
+    }
+}
+
+Bitboard attacks_from(PieceType pt, Square s, Bitboard occ) {
+    switch (pt) {
+        case KNIGHT: return bb::KnightAttacks[s];
+        case BISHOP: return bb::bishop_attacks(s, occ);
+        case ROOK:   return bb::rook_attacks(s, occ);
+        case QUEEN:  return bb::queen_attacks(s, occ);
+        case KING:   return bb::KingAttacks[s];
+        default:     return 0;
+    }
+}
+
+} // namespace
+
+// Rather than generating every legal move and matching, build the few
+// candidate moves the token can describe and check each with
+// pseudo_legal()/legal(), as for TT moves.
+Move parse_san(const Board& board, std::string_view san) {
+    while (!san.empty() && (san.back() == '+' || san.back() == '#'
+                            || san.back() == '!' || san.back() == '?'))
+        san.remove_suffix(1);
+    if (san.size() < 2) return Move::none();
+
+    Color us = board.side_to_move();
+    auto valid = [&](Move m) { return board.pseudo_legal(m) && board.legal(m); };
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        Square ksq = board.king_square(us);
+        Move m = san.size() == 3 ? Move(ksq, ksq + EAST + EAST, KING_CASTLE)
+                                 : Move(ksq, ksq + WEST + WEST, QUEEN_CASTLE);
+        return valid(m) ? m : Move::none();
+    }
+
+    PieceType pt = piece_from_letter(san[0]);
+    size_t begin = (pt == NO_PIECE_TYPE) ? 0 : 1;
+    if (pt == NO_PIECE_TYPE) pt = PAWN;
+
+    PieceType promo = NO_PIECE_TYPE;
+    if (pt == PAWN) {
+        if (san.size() >= 4 && san[san.size() - 2] == '=') {
+            promo = piece_from_letter(san.back());
+            san.remove_suffix(2);
+        } else if (piece_from_letter(san.back()) != NO_PIECE_TYPE) {
+            promo = piece_from_letter(san.back());
+            san.remove_suffix(1);
+        }
+        if (promo == KING) return Move::none();
+    }
+    if (san.size() < begin + 2) return Move::none();
+
+    char tf = san[san.size() - 2], tr = san[san.size() - 1];
+    if (tf < 'a' || tf > 'h' || tr < '1' || tr > '8') return Move::none();
+    Square to = make_square(tf - 'a', tr - '1');
+
+    // Whatever sits between the piece letter and the target square:
+    // disambiguation file and/or rank, and an optional capture mark
+    int from_file = -1, from_rank = -1;
+    for (char c : san.substr(begin, san.size() - 2 - begin)) {
+        if (c >= 'a' && c <= 'h')      from_file = c - 'a';
+        else if (c >= '1' && c <= '8') from_rank = c - '1';
+        else if (c != 'x' && c != ':' && c != '-') return Move::none();
+    }
+
+    bool capture = board.piece_on(to) != NO_PIECE;
+
+    if (pt == PAWN) {
+        Direction up = (us == WHITE) ? NORTH : SOUTH;
+        Square from = to - up;
+        MoveFlag flag = NORMAL;
+
+        if (from_file >= 0 && from_file != file_of(to)) {
+            if (from_file != file_of(to) - 1 && from_file != file_of(to) + 1) return Move::none();
+            from = make_square(from_file, rank_of(to - up));
+            flag = (to == board.ep_square()) ? EP_CAPTURE : CAPTURE;
+        } else if (board.piece_on(from) == NO_PIECE && relative_rank(us, to) == 3) {
+            from = from - up;
+            flag = DOUBLE_PUSH;
+        }
+
+        if (promo != NO_PIECE_TYPE)
+            flag = MoveFlag((capture ? PROMO_CAPTURE_KNIGHT : PROMO_KNIGHT) + (promo - KNIGHT));
+
+        Move m(from, to, flag);
+        return valid(m) ? m : Move::none();
+    }
+
+    Bitboard candidates = attacks_from(pt, to, board.pieces()) & board.pieces(us, pt);
+    if (from_file >= 0) candidates &= bb::file_bb(from_file);
+    if (from_rank >= 0) candidates &= bb::rank_bb(from_rank);
+
+    Move found = Move::none();
+    while (candidates) {
+        Move m(bb::pop_lsb(candidates), to, capture ? CAPTURE : NORMAL);
+        if (!valid(m)) continue;
+        if (found) return Move::none();   // ambiguous
+        found = m;
+    }
+    return found;
+}
+
+size_t write_san(const Board& board, Move m, char* out) {
+    char* p = out;
+    Square from = m.from(), to = m.to();
+    PieceType pt = piece_type(board.piece_on(from));
+
+    if (m.flags() == KING_CASTLE) {
+        for (char c : std::string_view("O-O")) *p++ = c;
+    } else if (m.flags() == QUEEN_CASTLE) {
+        for (char c : std::string_view("O-O-O")) *p++ = c;
+    } else {
+        if (pt == PAWN) {
+            if (m.is_capture()) *p++ = char('a' + file_of(from));
+        } else {
+            *p++ = PieceLetters[pt];
+
+            // Other pieces of the same type that can also reach `to`
+            MoveList moves;
+            generate_legal_moves(board, moves);
+            bool clash = false, same_file = false, same_rank = false;
+            for (Move o : moves) {
+                if (o.to() != to || o.from() == from) continue;
+                if (piece_type(board.piece_on(o.from())) != pt) continue;
+                clash = true;
+                same_file |= file_of(o.from()) == file_of(from);
+                same_rank |= rank_of(o.from()) == rank_of(from);
+            }
+            if (clash) {
+                if (!same_file)      *p++ = char('a' + file_of(from));
+                else if (!same_rank) *p++ = char('1' + rank_of(from));
+                else { *p++ = char('a' + file_of(from)); *p++ = char('1' + rank_of(from)); }
+            }
+        }
+        if (m.is_capture()) *p++ = 'x';
+        *p++ = char('a' + file_of(to));
+        *p++ = char('1' + rank_of(to));
+        if (m.is_promotion()) {
+            *p++ = '=';
+            *p++ = PieceLetters[m.promo_type()];
+        }
+    }
+
+    // Only a checking move can mate, so the reply count is only needed then
+    if (board.gives_check(m)) {
+        Board next = board;
+        StateInfo si;
+        next.make_move(m, si);
+        MoveList replies;
+        generate_legal_moves(next, replies);
+        *p++ = replies.count ? '+' : '#';
+    }
+    return size_t(p - out);
+}
+
+std::string to_san(const Board& board, Move m) {
+    char buf[MAX_SAN_LENGTH];
+    return std::string(buf, write_san(board, m, buf));
+}
+
+} // namespace chess
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "board.h"
+#include "move.h"
+#include <string>
+#include <string_view>
+
+namespace chess {
+
+// ── Standard Algebraic Notation ─────────────────────────────────────────
+// Longest SAN write_san produces ("Qa1xb2#", "exd8=Q+"), with room to spare
+constexpr size_t MAX_SAN_LENGTH = 12;
+
+// Resolves a SAN token against the legal moves of the position. Accepts
+// trailing check/annotation marks (+ # ! ?), "0-0" for "O-O", and
+// promotions with or without '='. Returns Move::none() if the token is
+// malformed, illegal or ambiguous. Does not allocate.
+Move parse_san(const Board& board, std::string_view san);
+
+// Writes the SAN of a legal move to out (no terminator), with minimal
+// disambiguation and a check or mate suffix. Returns the length.
+size_t write_san(const Board& board, Move m, char* out);
+std::string to_san(const Board& board, Move m);
+
+} // namespace chess
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <cassert>
@@ -57,6 +58,12 @@ constexpr int relative_rank(Color c, Square s) {
     return c == WHITE ? rank_of(s) : 7 - rank_of(s);
 }
 
+// King-move (Chebyshev) distance between two squares
+constexpr int distance(Square a, Square b) {
+    int df = file_of(a) - file_of(b), dr = rank_of(a) - rank_of(b);
+    return std::max(df < 0 ? -df : df, dr < 0 ? -dr : dr);
+}
+
 inline std::string square_to_string(Square s) {
     return std::string(1, char('a' + file_of(s))) + std::string(1, char('1' + rank_of(s)));
 }
@@ -133,9 +140,12 @@ constexpr int VALUE_NONE     = 32002;
 constexpr int VALUE_INFINITE = 32001;
 constexpr int VALUE_MATE     = 32000;
 constexpr int VALUE_DRAW     = 0;
+constexpr int VALUE_KNOWN_WIN = 10000;  // won endgame, well below any mate score
+
+constexpr int MAX_PLY = 256;   // deepest search line, root included
 
-constexpr int MATE_IN_MAX_PLY  =  VALUE_MATE - 256;
-constexpr int MATED_IN_MAX_PLY = -VALUE_MATE + 256;
+constexpr int MATE_IN_MAX_PLY  =  VALUE_MATE - MAX_PLY;
+constexpr int MATED_IN_MAX_PLY = -VALUE_MATE + MAX_PLY;
 
 constexpr bool is_mate_score(int v) {
     return v >= MATE_IN_MAX_PLY || v <= MATED_IN_MAX_PLY;
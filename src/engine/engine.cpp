@@ -1,5 +1,6 @@
 #include "engine.h"
 #include "../core/movegen.h"
+#include "../eval/material.h"
 
 namespace chess {
 
@@ -7,25 +8,26 @@ Engine::Engine() {
     new_game();
 }
 
-void Engine::ensure_state() {
-    if (states_.empty()) {
-        states_.emplace_back();
-    }
-    board_.set_state(&states_.back());
+void Engine::reset_states() {
+    states_.clear();
+    board_.set_state(&states_.push());
 }
 
 void Engine::new_game() {
-    states_.clear();
-    states_.emplace_back();
-    board_.set_state(&states_.back());
+    reset_states();
     board_.set_startpos();
 }
 
-void Engine::set_position(const std::string& fen) {
-    states_.clear();
-    states_.emplace_back();
-    board_.set_state(&states_.back());
+bool Engine::set_position(const std::string& fen) {
+    // Validate on a scratch board first so a bad FEN leaves the game as is
+    Board scratch;
+    StateInfo si;
+    scratch.set_state(&si);
+    if (scratch.set_fen(fen) != FenError::NONE) return false;
+
+    reset_states();
     board_.set_fen(fen);
+    return true;
 }
 
 void Engine::set_startpos() {
@@ -40,10 +42,9 @@ bool Engine::apply_move(Move m) {
     for (int i = 0; i < legal.count; ++i) {
         if (legal.moves[i] == m) { found = true; break; }
     }
-    if (!found) return false;
+    if (!found || states_.size() >= MAX_GAME_PLY) return false;
 
-    states_.emplace_back();
-    board_.make_move(m, states_.back());
+    board_.make_move(m, states_.push());
     return true;
 }
 
@@ -52,8 +53,20 @@ bool Engine::apply_uci_move(const std::string& uci) {
     return apply_move(m);
 }
 
+void Engine::undo_move(Move m) {
+    board_.undo_move(m);
+    states_.pop();
+}
+
 Move Engine::think(const SearchLimits& limits, InfoCallback on_info) {
-    return searcher_.search(board_, limits, states_, on_info);
+    SearchLimits l = limits;
+    if (l.threads <= 0) l.threads = threads_;
+    return searcher_.search(board_, l, states_, on_info);
+}
+
+void Engine::set_threads(int n) {
+    threads_ = std::clamp(n, 1, Searcher::MAX_THREADS);
+    searcher_.set_threads(threads_);
 }
 
 void Engine::stop_thinking() {
@@ -66,26 +79,38 @@ MoveList Engine::legal_moves() const {
     return list;
 }
 
+// in_check() is cached, so test it first and only generate moves when the
+// answer can still be yes
 bool Engine::is_checkmate() const {
+    if (!board_.in_check()) return false;
     MoveList moves;
     generate_legal_moves(board_, moves);
-    return moves.count == 0 && board_.in_check();
+    return moves.count == 0;
 }
 
 bool Engine::is_stalemate() const {
+    if (board_.in_check()) return false;
     MoveList moves;
     generate_legal_moves(board_, moves);
-    return moves.count == 0 && !board_.in_check();
+    return moves.count == 0;
 }
 
-bool Engine::is_draw() const {
-    return is_stalemate() || board_.halfmove_clock() >= 100;
+// Threefold repetition and dead material use the same detection as the
+// search (Board::is_threefold, material::Entry::dead_draw)
+DrawReason Engine::draw_reason() const {
+    if (is_stalemate()) return DrawReason::STALEMATE;
+    if (board_.halfmove_clock() >= 100 && !is_checkmate()) return DrawReason::FIFTY_MOVES;
+    if (board_.is_threefold()) return DrawReason::REPETITION;
+    if (material::probe(board_)->dead_draw) return DrawReason::MATERIAL;
+    return DrawReason::NONE;
 }
 
 bool Engine::is_game_over() const {
-    MoveList moves;
-    generate_legal_moves(board_, moves);
-    return moves.count == 0 || board_.halfmove_clock() >= 100;
+    return is_checkmate() || is_draw();
+}
+
+const char* Engine::slider_backend() const {
+    return bb::slider_backend_name(bb::slider_backend());
 }
 
 } // namespace chess
@@ -3,23 +3,45 @@
 #include "../core/board.h"
 #include "../core/move.h"
 #include "../search/search.h"
-#include <deque>
+#include <algorithm>
 #include <vector>
 
 namespace chess {
 
+enum class DrawReason { NONE, STALEMATE, FIFTY_MOVES, REPETITION, MATERIAL };
+
 class Engine {
 public:
     Engine();
 
     void new_game();
-    void set_position(const std::string& fen);
+    bool set_position(const std::string& fen);
     void set_startpos();
     bool apply_move(Move m);
     bool apply_uci_move(const std::string& uci);
+    // Takes back m, which must be the last move applied; not while thinking
+    void undo_move(Move m);
 
+    // limits.threads == 0 uses the count set here (1 by default)
     Move think(const SearchLimits& limits, InfoCallback on_info = nullptr);
+    // Call before handing think() to another thread, so a stop_thinking()
+    // or ponderhit() made before it starts still reaches it
+    void arm_thinking() { searcher_.arm(); }
+    // Stops the running think(); does nothing when idle
     void stop_thinking();
+    // Turns a think() with limits.ponder into a normal one, timed from now.
+    // The TT is kept between searches either way, so even a stopped ponder
+    // search leaves it warm for the next think().
+    void ponderhit() { searcher_.ponderhit(); }
+    // Sizes the search thread pool; not while thinking
+    void set_threads(int n);
+    int threads() const { return threads_; }
+
+    // Transposition table size; not while thinking. False (keeping the old
+    // size) if that much memory cannot be allocated.
+    bool set_hash_size(size_t mb) { return searcher_.resize_hash(mb); }
+    size_t hash_size() const { return searcher_.hash_mb(); }
+    void clear_hash() { searcher_.clear_hash(); }
 
     const Board& board() const { return board_; }
     Board& board() { return board_; }
@@ -30,14 +52,21 @@ public:
     bool is_game_over() const;
     bool is_checkmate() const;
     bool is_stalemate() const;
-    bool is_draw() const;
+    bool is_draw() const { return draw_reason() != DrawReason::NONE; }
+    DrawReason draw_reason() const;
+
+    // Slider attack backend bb::init() picked through CPUID ("magic" or "pext")
+    const char* slider_backend() const;
 
 private:
     Board board_;
     Searcher searcher_;
-    std::deque<StateInfo> states_;
+    int threads_ = 1;
+    // Game history followed by room for a full search line
+    static constexpr size_t MAX_GAME_PLY = 8192;
+    StateStack states_{MAX_GAME_PLY + MAX_PLY};
 
-    void ensure_state();
+    void reset_states();
 };
 
 } // namespace chess
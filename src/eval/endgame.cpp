@@ -0,0 +1,193 @@
+#include "endgame.h"
+#include "material.h"
+#include "pst.h"
+#include "../core/movegen.h"
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+namespace chess {
+namespace endgame {
+
+namespace {
+
+// Bonus for a king on the edge: 0 in the centre, 120 in a corner
+int push_to_edge(Square s) {
+    int edge = std::min(file_of(s), 7 - file_of(s)) + std::min(rank_of(s), 7 - rank_of(s));
+    return 20 * (6 - edge);
+}
+
+// Bonus for the attacking king standing close to the defending one
+int push_close(Square a, Square b) {
+    return 10 * (7 - distance(a, b));
+}
+
+int non_king_material(const Board& board, Color c) {
+    int v = 0;
+    for (int pt = PAWN; pt <= QUEEN; ++pt)
+        v += pst::PieceValue[pt] * board.count(c, PieceType(pt));
+    return v;
+}
+
+// ── KPK bitbase ─────────────────────────────────────────────────────────
+// One bit per position with white holding the pawn on files a-d: side to
+// move, both kings, and the pawn on ranks 2-7. Built by retrograde
+// iteration: positions start out won, drawn, invalid or unknown, and the
+// unknown ones are resolved from their successors until nothing changes.
+constexpr int KPK_SIZE = 2 * 24 * 64 * 64;
+
+enum : uint8_t { INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4 };
+
+uint32_t   KpkBits[KPK_SIZE / 32];
+std::once_flag kpk_once;
+
+int kpk_index(Color to_move, Square bk, Square wk, Square p) {
+    return int(wk) | (int(bk) << 6) | (int(to_move) << 12)
+         | (file_of(p) << 13) | ((6 - rank_of(p)) << 15);
+}
+
+struct KpkPosition {
+    Color  to_move;
+    Square wk, bk, p;
+
+    explicit KpkPosition(int idx)
+        : to_move(Color((idx >> 12) & 1)),
+          wk(Square(idx & 63)), bk(Square((idx >> 6) & 63)),
+          p(make_square((idx >> 13) & 3, 6 - (idx >> 15))) {}
+
+    uint8_t initial() const {
+        if (distance(wk, bk) <= 1 || wk == p || bk == p
+            || (to_move == WHITE && (bb::PawnAttacks[WHITE][p] & bb::square_bb(bk))))
+            return INVALID;
+
+        // The pawn promotes and the new queen cannot be taken
+        Square q = p + NORTH;
+        if (to_move == WHITE && rank_of(p) == 6 && wk != q
+            && (distance(bk, q) > 1 || distance(wk, q) == 1))
+            return WIN;
+
+        // Stalemate, or the undefended pawn falls
+        if (to_move == BLACK) {
+            Bitboard moves = bb::KingAttacks[bk] & ~bb::KingAttacks[wk];
+            if (!(moves & ~bb::PawnAttacks[WHITE][p]) || (moves & bb::square_bb(p)))
+                return DRAW;
+        }
+        return UNKNOWN;
+    }
+
+    // White needs one winning move, black one drawing move
+    uint8_t classify(const std::vector<uint8_t>& db) const {
+        uint8_t r = INVALID;
+        if (to_move == WHITE) {
+            for (Bitboard b = bb::KingAttacks[wk]; b; )
+                r |= db[kpk_index(BLACK, bk, bb::pop_lsb(b), p)];
+            if (rank_of(p) < 6) {
+                Square push = p + NORTH;
+                r |= db[kpk_index(BLACK, bk, wk, push)];
+                if (rank_of(p) == 1 && push != wk && push != bk)
+                    r |= db[kpk_index(BLACK, bk, wk, push + NORTH)];
+            }
+            return (r & WIN) ? WIN : (r & UNKNOWN) ? UNKNOWN : DRAW;
+        }
+        for (Bitboard b = bb::KingAttacks[bk]; b; )
+            r |= db[kpk_index(WHITE, bb::pop_lsb(b), wk, p)];
+        return (r & DRAW) ? DRAW : (r & UNKNOWN) ? UNKNOWN : WIN;
+    }
+};
+
+void init_kpk() {
+    std::vector<uint8_t> db(KPK_SIZE);
+    for (int i = 0; i < KPK_SIZE; ++i)
+        db[i] = KpkPosition(i).initial();
+
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = 0; i < KPK_SIZE; ++i) {
+            if (db[i] != UNKNOWN) continue;
+            uint8_t r = KpkPosition(i).classify(db);
+            if (r != UNKNOWN) {
+                db[i] = r;
+                changed = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < KPK_SIZE; ++i)
+        if (db[i] == WIN) KpkBits[i >> 5] |= 1u << (i & 31);
+}
+
+} // namespace
+
+bool kpk_win(Color strong, Square strong_king, Square pawn, Square weak_king, Color to_move) {
+    std::call_once(kpk_once, init_kpk);
+
+    // Normalize to white holding the pawn on files a-d
+    int flip = (strong == WHITE ? 0 : 56) ^ (file_of(pawn) >= 4 ? 7 : 0);
+    Square wk = Square(strong_king ^ flip), bk = Square(weak_king ^ flip);
+    Square p  = Square(pawn ^ flip);
+    Color stm = to_move == strong ? WHITE : BLACK;
+
+    int idx = kpk_index(stm, bk, wk, p);
+    return KpkBits[idx >> 5] & (1u << (idx & 31));
+}
+
+int draw(const Board&, Color) {
+    return VALUE_DRAW;
+}
+
+int kxk(const Board& board, Color strong) {
+    // A stalemated bare king has nothing left to fear
+    if (board.side_to_move() != strong) {
+        MoveList moves;
+        generate_legal_moves(board, moves);
+        if (moves.count == 0 && !board.in_check()) return VALUE_DRAW;
+    }
+
+    Square sk = board.king_square(strong);
+    Square wk = board.king_square(~strong);
+    int v = non_king_material(board, strong) + push_to_edge(wk) + push_close(sk, wk);
+
+    Bitboard bishops = board.pieces(strong, BISHOP);
+    if (board.pieces(strong, QUEEN, ROOK)
+        || (bishops && board.pieces(strong, KNIGHT))
+        || ((bishops & bb::DarkSquares) && (bishops & ~bb::DarkSquares)))
+        v += VALUE_KNOWN_WIN;
+    return v;
+}
+
+int kbnk(const Board& board, Color strong) {
+    Square sk = board.king_square(strong);
+    Square wk = board.king_square(~strong);
+
+    // Mate is only possible in a corner the bishop covers. Mirror the board
+    // for a light-squared bishop so that corner is always a1 or h8.
+    Square bishop = bb::lsb(board.pieces(strong, BISHOP));
+    Square corner_sq = (bb::DarkSquares & bb::square_bb(bishop)) ? wk : Square(wk ^ 7);
+    int to_a1 = file_of(corner_sq) + rank_of(corner_sq);
+    int to_h8 = 14 - to_a1;
+    int corner = std::min(to_a1, to_h8);   // 0 in the right corner, 7 in a wrong one
+
+    return VALUE_KNOWN_WIN + pst::PieceValue[KNIGHT] + pst::PieceValue[BISHOP]
+         + push_to_edge(wk) + 30 * (7 - corner) + push_close(sk, wk);
+}
+
+int kpk(const Board& board, Color strong) {
+    Square pawn = bb::lsb(board.pieces(strong, PAWN));
+    if (!kpk_win(strong, board.king_square(strong), pawn,
+                 board.king_square(~strong), board.side_to_move()))
+        return VALUE_DRAW;
+    return VALUE_KNOWN_WIN + pst::PieceValue[PAWN] + relative_rank(strong, pawn);
+}
+
+int scale_opposite_bishops(const Board& board) {
+    Bitboard bishops = board.pieces(BISHOP);
+    if (!(bishops & bb::DarkSquares) || !(bishops & ~bb::DarkSquares))
+        return material::SCALE_NORMAL;
+
+    // Even two extra pawns are often not enough
+    int pawn_diff = std::abs(board.count(WHITE, PAWN) - board.count(BLACK, PAWN));
+    return pawn_diff <= 1 ? 16 : 32;
+}
+
+} // namespace endgame
+} // namespace chess
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../core/board.h"
+
+namespace chess {
+namespace endgame {
+
+// Specialized evaluators for endgames the general evaluation misjudges.
+// Each scores the position for `strong`; material.cpp decides which one a
+// material signature gets.
+
+int draw(const Board& board, Color strong);   // no mating material on either side
+int kxk(const Board& board, Color strong);    // enough material against a bare king
+int kbnk(const Board& board, Color strong);   // bishop and knight against a bare king
+int kpk(const Board& board, Color strong);    // king and pawn against king, from a bitbase
+
+// Opposite-coloured bishops with only pawns besides
+int scale_opposite_bishops(const Board& board);
+
+// Whether the side with the pawn wins KPK. The bitbase is built on the
+// first call (a few milliseconds) and is read-only afterwards.
+bool kpk_win(Color strong, Square strong_king, Square pawn, Square weak_king, Color to_move);
+
+} // namespace endgame
+} // namespace chess
@@ -1,32 +1,25 @@
 #include "evaluation.h"
+#include "material.h"
 #include "pst.h"
 #include "../core/movegen.h"
 
 namespace chess {
 
-static bool is_endgame(const Board& board) {
-    // Endgame if no queens or only queens + pawns
-    Bitboard queens = board.pieces(QUEEN);
-    if (!queens) return true;
-    Bitboard non_pawn_non_king = board.pieces(KNIGHT) | board.pieces(BISHOP) |
-                                  board.pieces(ROOK) | board.pieces(QUEEN);
-    // Simple heuristic: few pieces left
-    return bb::popcount(non_pawn_non_king) <= 4;
-}
-
-static int eval_material_and_pst(const Board& board, Color c, bool endgame) {
+// Piece-square terms; material itself comes from the material entry. The
+// king blends its midgame and endgame tables by game phase.
+static int eval_pst(const Board& board, Color c, int phase) {
     int score = 0;
     for (int pt = PAWN; pt <= QUEEN; ++pt) {
         Bitboard pieces = board.pieces(c, PieceType(pt));
         while (pieces) {
             Square s = bb::pop_lsb(pieces);
-            score += pst::PieceValue[pt];
-            score += pst::value(c, PieceType(pt), s, endgame);
+            score += pst::value(c, PieceType(pt), s);
         }
     }
-    // King PST only
     Square ks = board.king_square(c);
-    score += pst::value(c, KING, ks, endgame);
+    score += (pst::value(c, KING, ks, false) * phase
+            + pst::value(c, KING, ks, true) * (material::PHASE_MIDGAME - phase))
+           / material::PHASE_MIDGAME;
     return score;
 }
 
@@ -81,11 +74,6 @@ static int eval_pawn_structure(const Board& board, Color c) {
     return score;
 }
 
-static int eval_bishop_pair(const Board& board, Color c) {
-    if (bb::popcount(board.pieces(c, BISHOP)) >= 2) return 30;
-    return 0;
-}
-
 static int eval_rook_files(const Board& board, Color c) {
     int score = 0;
     Bitboard rooks = board.pieces(c, ROOK);
@@ -106,8 +94,30 @@ static int eval_rook_files(const Board& board, Color c) {
     return score;
 }
 
-static int eval_king_safety(const Board& board, Color c, bool endgame) {
-    if (endgame) return 0;
+// Squares attacked by each piece type of each side, built once per
+// evaluation with the set-wise generators for the terms that only need
+// the union of a side's attacks. Per-piece counts (mobility) still loop.
+struct AttackMaps {
+    Bitboard by_type[COLOR_NB][PIECE_TYPE_NB];
+    Bitboard pieces[COLOR_NB]; // knights, bishops, rooks and queens combined
+};
+
+static void compute_attack_maps(const Board& board, AttackMaps& am) {
+    Bitboard occ = board.pieces();
+    for (Color c : {WHITE, BLACK}) {
+        Bitboard* t = am.by_type[c];
+        Bitboard pawns = board.pieces(c, PAWN);
+        t[PAWN]   = (c == WHITE) ? bb::shift_nw(pawns) | bb::shift_ne(pawns)
+                                 : bb::shift_sw(pawns) | bb::shift_se(pawns);
+        t[KNIGHT] = bb::knight_attacks_set(board.pieces(c, KNIGHT));
+        t[BISHOP] = bb::bishop_attacks_set(board.pieces(c, BISHOP), occ);
+        t[ROOK]   = bb::rook_attacks_set(board.pieces(c, ROOK), occ);
+        t[QUEEN]  = bb::queen_attacks_set(board.pieces(c, QUEEN), occ);
+        am.pieces[c] = t[KNIGHT] | t[BISHOP] | t[ROOK] | t[QUEEN];
+    }
+}
+
+static int eval_king_safety(const Board& board, const AttackMaps& am, Color c) {
     int score = 0;
     Square ks = board.king_square(c);
     int kf = file_of(ks);
@@ -123,74 +133,110 @@ static int eval_king_safety(const Board& board, Color c, bool endgame) {
                 score += 5;
         }
     }
+
+    // Enemy pieces bearing on the squares around the king
+    Bitboard king_zone = bb::KingAttacks[ks] | bb::square_bb(ks);
+    score -= 6 * bb::popcount(king_zone & am.pieces[~c]);
     return score;
 }
 
-static int eval_mobility(const Board& board, Color c) {
-    int mobility = 0;
+// Enemy pieces attacked by something cheaper: by a pawn, or a rook or
+// queen by a minor piece
+static int eval_threats(const Board& board, const AttackMaps& am, Color c) {
+    Bitboard minors = am.by_type[c][KNIGHT] | am.by_type[c][BISHOP];
+    Bitboard by_pawn  = am.by_type[c][PAWN] & board.pieces(~c) & ~board.pieces(PAWN, KING);
+    Bitboard by_minor = minors & board.pieces(~c, ROOK, QUEEN);
+    return 30 * bb::popcount(by_pawn) + 20 * bb::popcount(by_minor);
+}
+
+// Squares each piece reaches in its mobility area: not blocked by its own
+// pieces and not covered by an enemy pawn. Counted per piece.
+template<bb::SliderBackend B>
+static int eval_mobility(const Board& board, const AttackMaps& am, Color c) {
+    Bitboard area = ~(board.pieces(c) | am.by_type[~c][PAWN]);
     Bitboard occ = board.pieces();
+    int mobility = 0;
 
     // Knight mobility
     Bitboard knights = board.pieces(c, KNIGHT);
     while (knights) {
         Square s = bb::pop_lsb(knights);
-        mobility += bb::popcount(bb::KnightAttacks[s] & ~board.pieces(c));
+        mobility += bb::popcount(bb::KnightAttacks[s] & area);
     }
 
     // Bishop mobility
     Bitboard bishops = board.pieces(c, BISHOP);
     while (bishops) {
         Square s = bb::pop_lsb(bishops);
-        mobility += bb::popcount(bb::bishop_attacks(s, occ) & ~board.pieces(c));
+        mobility += bb::popcount(bb::bishop_attacks<B>(s, occ) & area);
     }
 
     // Rook mobility
     Bitboard rooks = board.pieces(c, ROOK);
     while (rooks) {
         Square s = bb::pop_lsb(rooks);
-        mobility += bb::popcount(bb::rook_attacks(s, occ) & ~board.pieces(c));
+        mobility += bb::popcount(bb::rook_attacks<B>(s, occ) & area);
     }
 
     // Queen mobility
     Bitboard queens = board.pieces(c, QUEEN);
     while (queens) {
         Square s = bb::pop_lsb(queens);
-        mobility += bb::popcount(bb::queen_attacks(s, occ) & ~board.pieces(c));
+        mobility += bb::popcount(bb::queen_attacks<B>(s, occ) & area);
     }
 
     return mobility * 2;
 }
 
+template<bb::SliderBackend B>
 int evaluate(const Board& board) {
-    bool endgame = is_endgame(board);
+    const material::Entry* me = material::probe(board);
+    if (me->evaluator) return me->evaluate(board);
 
-    int score = 0;
-    // Material + PST
-    score += eval_material_and_pst(board, WHITE, endgame);
-    score -= eval_material_and_pst(board, BLACK, endgame);
+    int phase = me->phase;
+
+    AttackMaps am;
+    compute_attack_maps(board, am);
+
+    // Material, bishop pair and imbalance
+    int score = me->imbalance;
+
+    // Piece-square tables
+    score += eval_pst(board, WHITE, phase);
+    score -= eval_pst(board, BLACK, phase);
 
     // Pawn structure
     score += eval_pawn_structure(board, WHITE);
     score -= eval_pawn_structure(board, BLACK);
 
-    // Bishop pair
-    score += eval_bishop_pair(board, WHITE);
-    score -= eval_bishop_pair(board, BLACK);
-
     // Rook on open files
     score += eval_rook_files(board, WHITE);
     score -= eval_rook_files(board, BLACK);
 
-    // King safety
-    score += eval_king_safety(board, WHITE, endgame);
-    score -= eval_king_safety(board, BLACK, endgame);
+    // King safety, fading out as material comes off
+    score += (eval_king_safety(board, am, WHITE) - eval_king_safety(board, am, BLACK))
+           * phase / material::PHASE_MIDGAME;
 
     // Mobility
-    score += eval_mobility(board, WHITE);
-    score -= eval_mobility(board, BLACK);
+    score += eval_mobility<B>(board, am, WHITE);
+    score -= eval_mobility<B>(board, am, BLACK);
+
+    // Threats
+    score += eval_threats(board, am, WHITE);
+    score -= eval_threats(board, am, BLACK);
+
+    if (me->scaling)
+        score = score * me->scaling(board) / material::SCALE_NORMAL;
 
     // Return from side-to-move perspective
     return (board.side_to_move() == WHITE) ? score : -score;
 }
 
+template int evaluate<bb::SliderBackend::MAGIC>(const Board& board);
+template int evaluate<bb::SliderBackend::PEXT>(const Board& board);
+
+int evaluate(const Board& board) {
+    return bb::with_slider_backend([&]<bb::SliderBackend B> { return evaluate<B>(board); });
+}
+
 } // namespace chess
@@ -4,6 +4,9 @@
 
 namespace chess {
 
+// B is the slider backend (bitboard.h); the plain form looks it up
+template<bb::SliderBackend B>
+int evaluate(const Board& board);
 int evaluate(const Board& board);
 
 } // namespace chess
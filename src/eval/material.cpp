@@ -0,0 +1,99 @@
+#include "material.h"
+#include "endgame.h"
+#include "pst.h"
+#include <memory>
+
+namespace chess {
+namespace material {
+
+namespace {
+
+constexpr size_t TABLE_SIZE = 8192;   // entries per thread, power of two
+
+thread_local std::unique_ptr<Entry[]> table;
+
+struct Counts {
+    int n[COLOR_NB][PIECE_TYPE_NB];
+
+    explicit Counts(const Board& board) {
+        for (Color c : {WHITE, BLACK})
+            for (int pt = PAWN; pt <= KING; ++pt)
+                n[c][pt] = board.count(c, PieceType(pt));
+    }
+
+    int non_pawn(Color c) const {
+        return n[c][KNIGHT] * pst::PieceValue[KNIGHT] + n[c][BISHOP] * pst::PieceValue[BISHOP]
+             + n[c][ROOK] * pst::PieceValue[ROOK] + n[c][QUEEN] * pst::PieceValue[QUEEN];
+    }
+    bool bare_king(Color c) const { return non_pawn(c) == 0 && n[c][PAWN] == 0; }
+};
+
+// Material and the adjustments that depend on it alone: the bishop pair,
+// and knights gaining and rooks losing value as pawns come off
+int imbalance(const Counts& k, Color c) {
+    int v = k.non_pawn(c) + k.n[c][PAWN] * pst::PieceValue[PAWN];
+    if (k.n[c][BISHOP] >= 2) v += 30;
+    v += k.n[c][KNIGHT] * 6 * (k.n[c][PAWN] - 5);
+    v -= k.n[c][ROOK] * 12 * (k.n[c][PAWN] - 5);
+    return v;
+}
+
+void compute(const Board& board, Entry& e) {
+    Counts k(board);
+
+    e.evaluator   = nullptr;
+    e.scaling     = nullptr;
+    e.dead_draw   = false;
+    e.strong_side = WHITE;
+    e.imbalance   = int16_t(imbalance(k, WHITE) - imbalance(k, BLACK));
+
+    int phase = 0;
+    for (Color c : {WHITE, BLACK})
+        phase += k.n[c][KNIGHT] + k.n[c][BISHOP] + 2 * k.n[c][ROOK] + 4 * k.n[c][QUEEN];
+    e.phase = uint8_t(std::min(phase, PHASE_MIDGAME));
+
+    // No pawns and at most a single minor piece: nobody can ever mate
+    if (!k.n[WHITE][PAWN] && !k.n[BLACK][PAWN]
+        && k.non_pawn(WHITE) + k.non_pawn(BLACK) <= pst::PieceValue[BISHOP]) {
+        e.evaluator = endgame::draw;
+        e.dead_draw = true;
+        return;
+    }
+
+    for (Color c : {WHITE, BLACK}) {
+        if (!k.bare_king(~c)) continue;
+        e.strong_side = c;
+        if (k.n[c][KNIGHT] == 1 && k.n[c][BISHOP] == 1 && !k.n[c][PAWN]
+            && k.non_pawn(c) == pst::PieceValue[KNIGHT] + pst::PieceValue[BISHOP])
+            e.evaluator = endgame::kbnk;
+        else if (k.n[c][PAWN] == 1 && k.non_pawn(c) == 0)
+            e.evaluator = endgame::kpk;
+        else if (k.non_pawn(c) >= pst::PieceValue[ROOK])
+            e.evaluator = endgame::kxk;
+        return;
+    }
+
+    // One bishop each and only pawns besides; the scale function checks
+    // the square colours, which the material key cannot see
+    if (k.n[WHITE][BISHOP] == 1 && k.n[BLACK][BISHOP] == 1
+        && k.non_pawn(WHITE) == pst::PieceValue[BISHOP]
+        && k.non_pawn(BLACK) == pst::PieceValue[BISHOP])
+        e.scaling = endgame::scale_opposite_bishops;
+}
+
+} // namespace
+
+const Entry* probe(const Board& board) {
+    if (!table) table = std::make_unique<Entry[]>(TABLE_SIZE);
+
+    uint64_t key = board.material_key();
+    Entry& e = table[key & (TABLE_SIZE - 1)];
+    if (e.key != key) {
+        compute(board, e);
+        e.key = key;
+    }
+    return &e;
+}
+
+} // namespace material
+} // namespace chess
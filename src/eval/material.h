@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../core/board.h"
+
+namespace chess {
+namespace material {
+
+// Game phase from the non-pawn material left: minors count 1, rooks 2 and
+// queens 4, so the starting position is PHASE_MIDGAME and bare kings are 0
+constexpr int PHASE_MIDGAME = 24;
+
+// Scale factors are out of SCALE_NORMAL
+constexpr int SCALE_NORMAL = 64;
+
+// Scores a known endgame from the strong side's point of view
+using EndgameFn = int (*)(const Board& board, Color strong);
+// Scale factor for the score of a position that is otherwise evaluated normally
+using ScaleFn = int (*)(const Board& board);
+
+// Everything evaluate() needs that depends only on the material on the
+// board, cached under Board::material_key()
+struct Entry {
+    uint64_t  key;
+    EndgameFn evaluator;    // replaces the full evaluation when set
+    ScaleFn   scaling;      // scales the full evaluation when set
+    int16_t   imbalance;    // piece values, bishop pair and pawn-count adjustments, white's view
+    uint8_t   phase;        // PHASE_MIDGAME down to 0
+    bool      dead_draw;    // neither side has mating material, whatever the position
+    Color     strong_side;  // side the evaluator scores for
+
+    // Known-endgame score from the side to move's point of view
+    int evaluate(const Board& board) const {
+        int v = evaluator(board, strong_side);
+        return board.side_to_move() == strong_side ? v : -v;
+    }
+};
+
+// The entry for the board's material, computed on a miss. Each thread has
+// its own table, so search threads never contend on it.
+const Entry* probe(const Board& board);
+
+} // namespace material
+} // namespace chess
@@ -0,0 +1,72 @@
+#include "epd.h"
+#include <algorithm>
+
+namespace chess {
+
+namespace {
+
+bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool all_digits(std::string_view s) {
+    return !s.empty() && std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+} // namespace
+
+std::string_view epd_op(std::string_view ops, std::string_view opcode) {
+    std::string_view result;
+    bool found = false;
+    for_each_epd_op(ops, [&](std::string_view code, std::string_view operands) {
+        if (!found && code == opcode) { result = operands; found = true; }
+    });
+    return result;
+}
+
+bool split_epd_line(std::string_view line, EpdRecord& rec) {
+    const char* p = line.data();
+    const char* end = p + line.size();
+    while (p < end && is_blank(*p)) ++p;
+    if (p == end || *p == '#') return false;
+
+    // Four mandatory fields, then up to two numeric move counters
+    const char* fen_begin = p;
+    const char* fen_end = p;
+    for (int field = 0; field < 6 && p < end; ++field) {
+        const char* tok = p;
+        while (p < end && !is_blank(*p)) ++p;
+        if (field >= 4 && !all_digits({tok, size_t(p - tok)})) { p = tok; break; }
+        fen_end = p;
+        while (p < end && is_blank(*p)) ++p;
+    }
+
+    while (end > p && is_blank(end[-1])) --end;
+    rec.fen = {fen_begin, size_t(fen_end - fen_begin)};
+    rec.ops = {p, size_t(end - p)};
+    return true;
+}
+
+bool EpdReader::open(const std::string& path) {
+    pos_ = 0;
+    line_ = 0;
+    return file_.open(path);
+}
+
+bool EpdReader::next_chunk(std::vector<EpdRecord>& out, size_t max_records) {
+    out.clear();
+    std::string_view data = file_.data();
+
+    while (pos_ < data.size() && out.size() < max_records) {
+        size_t eol = data.find('\n', pos_);
+        if (eol == std::string_view::npos) eol = data.size();
+
+        EpdRecord rec;
+        rec.line = ++line_;
+        if (split_epd_line(data.substr(pos_, eol - pos_), rec))
+            out.push_back(rec);
+        pos_ = eol + 1;
+    }
+    pos_ = std::min(pos_, data.size());
+    return !out.empty();
+}
+
+} // namespace chess
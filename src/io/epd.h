@@ -0,0 +1,75 @@
+#pragma once
+
+#include "mapped_file.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace chess {
+
+// One line of an EPD or FEN file. Both views point into the reader's
+// mapped file and stay valid while the reader is open.
+struct EpdRecord {
+    std::string_view fen;   // four FEN fields, plus the move counters if present
+    std::string_view ops;   // raw EPD operations after the FEN, may be empty
+    uint32_t line;          // 1-based line number
+};
+
+// Calls f(opcode, operands) for each operation in an EPD ops string, as in
+// `bm Nf3; id "pos 1";` or `;D1 20 ;D2 400`. Semicolons inside quotes do
+// not end an operation.
+template<typename F>
+void for_each_epd_op(std::string_view ops, F&& f) {
+    auto trim = [](std::string_view s) {
+        size_t b = s.find_first_not_of(" \t");
+        if (b == std::string_view::npos) return std::string_view{};
+        size_t e = s.find_last_not_of(" \t");
+        return s.substr(b, e - b + 1);
+    };
+
+    size_t start = 0;
+    bool quoted = false;
+    for (size_t i = 0; i <= ops.size(); ++i) {
+        if (i < ops.size() && ops[i] == '"') quoted = !quoted;
+        if (i < ops.size() && (quoted || ops[i] != ';')) continue;
+
+        std::string_view op = trim(ops.substr(start, i - start));
+        start = i + 1;
+        if (op.empty()) continue;
+
+        size_t sep = op.find_first_of(" \t");
+        std::string_view opcode = op.substr(0, sep);
+        std::string_view operands = sep == std::string_view::npos ? std::string_view{}
+                                                                  : trim(op.substr(sep));
+        f(opcode, operands);
+    }
+}
+
+// Operands of the first operation named opcode, or an empty view
+std::string_view epd_op(std::string_view ops, std::string_view opcode);
+
+// Splits one line into FEN and operations. Returns false for blank lines
+// and '#' comments.
+bool split_epd_line(std::string_view line, EpdRecord& rec);
+
+// Streams the records of an EPD/FEN file in chunks, straight from the
+// mapped file: no copies, and no allocation once `out` has grown.
+class EpdReader {
+public:
+    bool open(const std::string& path);
+
+    // Replaces the contents of out with up to max_records records.
+    // Returns false once the file is exhausted.
+    bool next_chunk(std::vector<EpdRecord>& out, size_t max_records = 4096);
+
+    size_t bytes_read() const { return pos_; }
+    size_t size() const { return file_.size(); }
+
+private:
+    MappedFile file_;
+    size_t pos_ = 0;
+    uint32_t line_ = 0;
+};
+
+} // namespace chess
@@ -0,0 +1,63 @@
+#include "mapped_file.h"
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHESTRAT_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace chess {
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+#ifdef CHESTRAT_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+    size_ = size_t(st.st_size);
+
+    if (size_ > 0) {
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) { ::close(fd); size_ = 0; return false; }
+        // Readers walk the file front to back
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p);
+        mapped_ = true;
+    }
+    ::close(fd);
+#else
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::fseek(f, 0, SEEK_END);
+    long len = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    if (len < 0) { std::fclose(f); return false; }
+    size_ = size_t(len);
+    buffer_ = std::make_unique<char[]>(size_ + 1);
+    size_ = std::fread(buffer_.get(), 1, size_, f);
+    std::fclose(f);
+    data_ = buffer_.get();
+#endif
+
+    open_ = true;
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef CHESTRAT_HAS_MMAP
+    if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+    buffer_.reset();
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+    mapped_ = false;
+}
+
+} // namespace chess
@@ -0,0 +1,186 @@
+#include "pgn.h"
+#include "../core/san.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace chess {
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 1 << 20;
+constexpr size_t MAX_GAME_PLY = 4096;
+
+bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+bool is_result(std::string_view tok) {
+    return tok == "1-0" || tok == "0-1" || tok == "1/2-1/2" || tok == "*";
+}
+
+// Calls f(san) for each mainline move token; stops at the result or when
+// f returns false. Returns false if f did.
+template<typename F>
+bool for_each_san(std::string_view text, F&& f) {
+    size_t i = 0, n = text.size();
+    int depth = 0;   // variation nesting
+
+    while (i < n) {
+        char c = text[i];
+        if (is_blank(c)) { ++i; continue; }
+        if (c == '{') {
+            size_t close = text.find('}', i);
+            i = close == std::string_view::npos ? n : close + 1;
+            continue;
+        }
+        if (c == ';') {
+            size_t eol = text.find('\n', i);
+            i = eol == std::string_view::npos ? n : eol + 1;
+            continue;
+        }
+        if (c == '(') { ++depth; ++i; continue; }
+        if (c == ')') { depth -= depth > 0; ++i; continue; }
+
+        size_t j = i;
+        while (j < n && !is_blank(text[j]) && text[j] != '{' && text[j] != '('
+               && text[j] != ')' && text[j] != ';')
+            ++j;
+        std::string_view tok = text.substr(i, j - i);
+        i = j;
+
+        if (depth > 0 || tok[0] == '$') continue;
+        if (is_result(tok)) return true;
+
+        // Move number, possibly glued to the move ("12.e4", "12...Nf6")
+        if (is_digit(tok[0])) {
+            size_t k = 0;
+            while (k < tok.size() && is_digit(tok[k])) ++k;
+            if (k < tok.size() && tok[k] == '.') {
+                while (k < tok.size() && tok[k] == '.') ++k;
+                tok.remove_prefix(k);
+                if (tok.empty()) continue;
+            }
+        }
+        if (!f(tok)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string_view PgnGame::tag(std::string_view name) const {
+    size_t pos = 0;
+    while ((pos = tags.find('[', pos)) != std::string_view::npos) {
+        ++pos;
+        if (tags.substr(pos, name.size()) != name) continue;
+        size_t q = pos + name.size();
+        if (q >= tags.size() || !is_blank(tags[q])) continue;
+        size_t open = tags.find('"', q);
+        if (open == std::string_view::npos) break;
+        size_t close = open + 1;
+        while (close < tags.size() && tags[close] != '"')
+            close += tags[close] == '\\' ? 2 : 1;
+        if (close >= tags.size()) break;
+        return tags.substr(open + 1, close - open - 1);
+    }
+    return {};
+}
+
+bool PgnReader::open(const std::string& path) {
+    return file_.open(path);
+}
+
+// A game starts at a '[' that begins a line, unless the last non-blank
+// line before it is a tag too (then it is just the game's next tag).
+size_t PgnReader::next_game_start(size_t pos) const {
+    std::string_view data = file_.data();
+    size_t p = pos;
+    if (p > 0 && p < data.size() && data[p - 1] != '\n') {
+        p = data.find('\n', p);
+        if (p == std::string_view::npos) return data.size();
+        ++p;
+    }
+
+    while (p < data.size()) {
+        if (data[p] == '[') {
+            size_t q = p;
+            while (q > 0 && is_blank(data[q - 1])) --q;
+            if (q == 0) return p;
+            size_t line = data.rfind('\n', q - 1);
+            line = line == std::string_view::npos ? 0 : line + 1;
+            if (data[line] != '[') return p;
+        }
+        p = data.find('\n', p);
+        if (p == std::string_view::npos) break;
+        ++p;
+    }
+    return data.size();
+}
+
+PgnStats PgnReader::replay(int threads, const PgnMoveCallback& on_move,
+                           const PgnGameCallback& on_game) const {
+    std::string_view data = file_.data();
+    size_t num_blocks = (data.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::atomic<size_t> next_block{0};
+    std::vector<PgnStats> stats(std::max(threads, 1));
+
+    auto worker = [&](int thread) {
+        PgnStats& st = stats[thread];
+        StateStack states(MAX_GAME_PLY);
+        Board board;
+
+        for (size_t b; (b = next_block.fetch_add(1)) < num_blocks; ) {
+            size_t block_end = std::min((b + 1) * BLOCK_SIZE, data.size());
+
+            for (size_t g = next_game_start(b * BLOCK_SIZE); g < block_end; ) {
+                // Tag section: the run of lines starting with '['
+                size_t tags_end = g;
+                while (tags_end < data.size() && data[tags_end] == '[') {
+                    size_t eol = data.find('\n', tags_end);
+                    tags_end = eol == std::string_view::npos ? data.size() : eol + 1;
+                }
+                size_t end = next_game_start(tags_end);
+
+                PgnGame game{data.substr(g, tags_end - g), data.substr(tags_end, end - tags_end)};
+                g = end;
+                ++st.games;
+
+                states.clear();
+                board.set_state(&states.push());
+                // A bad FEN tag leaves the board as it was, so fall back to
+                // the start position rather than the previous game's
+                std::string_view fen = game.tag("FEN");
+                bool ok = fen.empty() || board.set_fen(fen) == FenError::NONE;
+                if (fen.empty() || !ok) board.set_startpos();
+
+                ok = ok && for_each_san(game.movetext, [&](std::string_view san) {
+                    Move m = parse_san(board, san);
+                    if (!m || states.full()) return false;
+                    if (on_move) on_move(board, m, thread);
+                    board.make_move(m, states.push());
+                    ++st.moves;
+                    return true;
+                });
+
+                st.bad_games += !ok;
+                if (on_game) on_game(game, board, ok, thread);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& t : pool) t.join();
+
+    PgnStats total;
+    for (const PgnStats& s : stats) {
+        total.games += s.games;
+        total.moves += s.moves;
+        total.bad_games += s.bad_games;
+    }
+    return total;
+}
+
+} // namespace chess
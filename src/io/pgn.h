@@ -0,0 +1,58 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "../core/board.h"
+#include "../core/move.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace chess {
+
+// One game of a PGN file, as views into the reader's mapped file
+struct PgnGame {
+    std::string_view tags;       // tag pair section, "[Name "value"]" lines
+    std::string_view movetext;
+
+    // Value of tag `name`, or an empty view. Escapes are left as they are.
+    std::string_view tag(std::string_view name) const;
+};
+
+struct PgnStats {
+    uint64_t games = 0;
+    uint64_t moves = 0;
+    uint64_t bad_games = 0;     // unparseable FEN tag, or an illegal/unknown SAN move
+};
+
+// Called for each move, with the position before it. `thread` tells the
+// caller which worker is running (0..threads-1), for per-thread output.
+using PgnMoveCallback = std::function<void(const Board& board, Move m, int thread)>;
+
+// Called after each game with the final position. ok is false if replay
+// stopped at a bad move; board is then the position before that move. A
+// game whose FEN tag does not parse is reported with the start position.
+using PgnGameCallback = std::function<void(const PgnGame& game, const Board& board,
+                                           bool ok, int thread)>;
+
+// Replays every game of a (possibly multi-gigabyte) PGN file. The file is
+// memory-mapped and cut into blocks; workers claim blocks and replay the
+// games that start in them, so blocks are parsed in parallel and nothing
+// is copied out of the mapping. Variations, comments and NAGs are skipped.
+// Callbacks run concurrently on the worker threads.
+class PgnReader {
+public:
+    bool open(const std::string& path);
+    size_t size() const { return file_.size(); }
+
+    PgnStats replay(int threads, const PgnMoveCallback& on_move,
+                    const PgnGameCallback& on_game = nullptr) const;
+
+    // Offset of the first game starting at or after pos, or size() if none
+    size_t next_game_start(size_t pos) const;
+
+private:
+    MappedFile file_;
+};
+
+} // namespace chess
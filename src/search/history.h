@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../core/board.h"
+#include "../core/move.h"
+#include <cstdlib>
+
+namespace chess {
+
+// Quiet-move ordering statistics. Each search thread keeps its own, so
+// they are never shared or locked.
+//   killers:      the last two quiet moves that caused a cutoff at each ply
+//   butterfly:    cutoff history by side, from and to square
+//   countermoves: the quiet reply that refuted the previous move, keyed by
+//                 the piece that made it and its destination
+struct MoveHistory {
+    static constexpr int HISTORY_MAX = 16384;
+
+    Move    killers[MAX_PLY + 1][2];
+    int16_t butterfly[COLOR_NB][SQUARE_NB][SQUARE_NB];
+    Move    countermoves[PIECE_NB][SQUARE_NB];
+
+    void clear() { *this = MoveHistory{}; }
+
+    // Halve the butterfly scores, so a new iteration or search still starts
+    // from what the last one learned but is not ruled by it
+    void age() {
+        for (auto& side : butterfly)
+            for (auto& from : side)
+                for (auto& v : from) v /= 2;
+    }
+
+    int score(Color c, Move m) const { return butterfly[c][m.from()][m.to()]; }
+
+    // Gravity update: the entry moves by `bonus`, less as it nears the
+    // bound, so scores stay within +-HISTORY_MAX without rescaling
+    void update(Color c, Move m, int bonus) {
+        int16_t& e = butterfly[c][m.from()][m.to()];
+        e += int16_t(bonus - e * std::abs(bonus) / HISTORY_MAX);
+    }
+
+    void add_killer(int ply, Move m) {
+        if (killers[ply][0] != m) {
+            killers[ply][1] = killers[ply][0];
+            killers[ply][0] = m;
+        }
+    }
+};
+
+} // namespace chess
@@ -0,0 +1,156 @@
+#include "movepick.h"
+#include "../eval/pst.h"
+#include <utility>
+
+namespace chess {
+
+template<bb::SliderBackend B>
+MovePicker<B>::MovePicker(const Board& board, Move tt_move, bool captures_only)
+    : board_(board), tt_move_(Move::none()), stage_(TT_MOVE), captures_only_(captures_only)
+{
+    // The TT move may come from a different position that hashed to the same
+    // key, so it is only tried first if it is legal here
+    if (tt_move && (!captures_only || tt_move.is_capture())
+        && board.pseudo_legal<B>(tt_move) && board.legal<B>(tt_move))
+        tt_move_ = tt_move;
+    if (!tt_move_) stage_ = CAPTURE_INIT;
+}
+
+template<bb::SliderBackend B>
+MovePicker<B>::MovePicker(const Board& board, Move tt_move, const MoveHistory& history,
+                          const Move killers[2], Move countermove)
+    : MovePicker(board, tt_move)
+{
+    history_ = &history;
+    refutations_[0] = killers[0];
+    refutations_[1] = killers[1];
+    refutations_[2] = countermove;
+}
+
+template<bb::SliderBackend B>
+bool MovePicker<B>::is_refutation(Move m) const {
+    return m == refutations_[0] || m == refutations_[1] || m == refutations_[2];
+}
+
+// MVV-LVA, with the promotion piece counted as extra material
+template<bb::SliderBackend B>
+void MovePicker<B>::score_captures() {
+    for (int i = 0; i < moves_.count; ++i) {
+        Move m = moves_.moves[i];
+        PieceType victim = (m.flags() == EP_CAPTURE) ? PAWN : piece_type(board_.piece_on(m.to()));
+        PieceType attacker = piece_type(board_.piece_on(m.from()));
+        scores_[i] = pst::PieceValue[victim] * 10 - pst::PieceValue[attacker];
+        if (m.is_promotion())
+            scores_[i] += pst::PieceValue[m.promo_type()];
+    }
+}
+
+// Selection step: swap the best remaining move to cur_ and return it
+template<bb::SliderBackend B>
+Move MovePicker<B>::pick_best() {
+    int best = cur_;
+    for (int j = cur_ + 1; j < moves_.count; ++j) {
+        if (scores_[j] > scores_[best]) best = j;
+    }
+    if (best != cur_) {
+        std::swap(moves_.moves[cur_], moves_.moves[best]);
+        std::swap(scores_[cur_], scores_[best]);
+    }
+    return moves_.moves[cur_++];
+}
+
+template<bb::SliderBackend B>
+Move MovePicker<B>::next_move() {
+    switch (stage_) {
+        case TT_MOVE:
+            stage_ = CAPTURE_INIT;
+            return tt_move_;
+
+        case CAPTURE_INIT: {
+            generate_legal<CAPTURES_ONLY, B>(board_, moves_);
+
+            // Move quiet queen promotions out to their own stage
+            int n = 0;
+            for (int i = 0; i < moves_.count; ++i) {
+                Move m = moves_.moves[i];
+                if (m.is_capture()) moves_.moves[n++] = m;
+                else promos_[promo_count_++] = m;
+            }
+            moves_.count = n;
+
+            score_captures();
+            cur_ = 0;
+            stage_ = GOOD_CAPTURE;
+            [[fallthrough]];
+        }
+
+        case GOOD_CAPTURE:
+            while (cur_ < moves_.count) {
+                Move m = pick_best();
+                if (m == tt_move_) continue;
+                if (board_.see_ge<B>(m)) return m;
+                moves_.moves[bad_count_++] = m;
+            }
+            stage_ = PROMOTION;
+            [[fallthrough]];
+
+        case PROMOTION:
+            while (promo_cur_ < promo_count_) {
+                Move m = promos_[promo_cur_++];
+                if (m != tt_move_) return m;
+            }
+            if (captures_only_) {
+                stage_ = DONE;
+                return Move::none();
+            }
+            stage_ = REFUTATION;
+            [[fallthrough]];
+
+        case REFUTATION:
+            while (refutation_cur_ < 3) {
+                Move& m = refutations_[refutation_cur_++];
+                bool repeat = refutation_cur_ == 3 && (m == refutations_[0] || m == refutations_[1]);
+                if (!m || m == tt_move_ || repeat || m.is_capture() || m.is_promotion()
+                    || !board_.pseudo_legal<B>(m) || !board_.legal<B>(m)) {
+                    m = Move::none();
+                    continue;
+                }
+                return m;
+            }
+            stage_ = QUIET_INIT;
+            [[fallthrough]];
+
+        case QUIET_INIT: {
+            moves_.count = bad_count_;
+            generate_legal<QUIETS_ONLY, B>(board_, moves_);
+            Color us = board_.side_to_move();
+            for (int i = bad_count_; i < moves_.count; ++i)
+                scores_[i] = history_ ? history_->score(us, moves_.moves[i]) : 0;
+            cur_ = bad_count_;
+            stage_ = QUIET;
+            [[fallthrough]];
+        }
+
+        case QUIET:
+            while (cur_ < moves_.count) {
+                Move m = pick_best();
+                if (m != tt_move_ && !is_refutation(m)) return m;
+            }
+            stage_ = BAD_CAPTURE;
+            [[fallthrough]];
+
+        case BAD_CAPTURE:
+            if (bad_cur_ < bad_count_) return moves_.moves[bad_cur_++];
+            stage_ = DONE;
+            [[fallthrough]];
+
+        case DONE:
+            return Move::none();
+    }
+    return Move::none();
+}
+
+template class MovePicker<bb::SliderBackend::MAGIC>;
+template class MovePicker<bb::SliderBackend::PEXT>;
+
+} // namespace chess
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../core/board.h"
+#include "../core/move.h"
+#include "../core/movegen.h"
+#include "history.h"
+
+namespace chess {
+
+// Staged move ordering. Each stage is generated and scored only once the
+// previous one is used up, so a cutoff on the TT move or an early capture
+// skips the rest of the work:
+//   TT move -> winning and even captures (MVV-LVA) -> queen push-promotions
+//           -> killers and countermove -> quiets (by history)
+//           -> losing captures
+// Captures are sorted into winning and losing by Board::see_ge as they come
+// up. A captures-only picker (quiescence) drops the losing ones and stops
+// after the promotions. Without a MoveHistory there are no refutations and
+// quiets keep generation order. B is the slider backend (bitboard.h).
+template<bb::SliderBackend B>
+class MovePicker {
+public:
+    MovePicker(const Board& board, Move tt_move, bool captures_only = false);
+    MovePicker(const Board& board, Move tt_move, const MoveHistory& history,
+               const Move killers[2], Move countermove);
+
+    // Next move in order, or Move::none() when exhausted
+    Move next_move();
+
+private:
+    enum Stage {
+        TT_MOVE, CAPTURE_INIT, GOOD_CAPTURE, PROMOTION, REFUTATION, QUIET_INIT, QUIET,
+        BAD_CAPTURE, DONE
+    };
+
+    void score_captures();
+    Move pick_best();
+    bool is_refutation(Move m) const;
+
+    const Board& board_;
+    Move tt_move_;
+    Stage stage_;
+    bool captures_only_;
+    const MoveHistory* history_ = nullptr;
+
+    // Killers then countermove; entries that are not legal quiet moves here
+    // are cleared when their stage comes up
+    Move refutations_[3] = {};
+    int refutation_cur_ = 0;
+
+    MoveList moves_;
+    int scores_[256];
+    int cur_ = 0;
+
+    // Losing captures are moved to the front of moves_, behind cur_, and
+    // the quiets are generated after them
+    int bad_count_ = 0;
+    int bad_cur_ = 0;
+
+    // Quiet queen promotions, split off the captures list
+    Move promos_[8];
+    int promo_count_ = 0;
+    int promo_cur_ = 0;
+};
+
+} // namespace chess
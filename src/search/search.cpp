@@ -1,112 +1,326 @@
 #include "search.h"
+#include "movepick.h"
 #include "../core/movegen.h"
 #include "../eval/evaluation.h"
+#include "../eval/material.h"
 #include "../eval/pst.h"
-#include <chrono>
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <thread>
 
 namespace chess {
 
-static int64_t now_ms() {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now().time_since_epoch()).count();
+// Plies of game history copied to each helper, enough to see every
+// repetition the 50-move rule leaves possible
+static constexpr int HISTORY_PLIES = 128;
+
+// Late move reductions, growing with the log of both the depth and the
+// move number
+static const auto Reductions = [] {
+    std::array<std::array<int8_t, 64>, 64> r{};
+    for (int d = 1; d < 64; ++d)
+        for (int m = 1; m < 64; ++m)
+            r[d][m] = int8_t(0.75 + std::log(d) * std::log(m) / 2.25);
+    return r;
+}();
+
+// Mate scores count plies from the root, but an entry can be reached again
+// at another ply, or in a later search from another root. The TT holds them
+// as distances from the node itself.
+static int score_to_tt(int score, int ply) {
+    return score >= MATE_IN_MAX_PLY ? score + ply
+         : score <= MATED_IN_MAX_PLY ? score - ply : score;
 }
 
-Searcher::Searcher() : tt_(64), stop_flag_(false), nodes_(0), start_time_(0), time_limit_(0) {}
+static int score_from_tt(int score, int ply) {
+    return score >= MATE_IN_MAX_PLY ? score - ply
+         : score <= MATED_IN_MAX_PLY ? score + ply : score;
+}
 
-bool Searcher::should_stop() {
-    if (stop_flag_.load(std::memory_order_relaxed)) return true;
-    if ((nodes_ & (CHECK_NODES - 1)) == 0) {
-        if (now_ms() - start_time_ >= time_limit_) {
-            stop_flag_.store(true);
-            return true;
+struct Searcher::Thread {
+    explicit Thread(int id) : id(id) {
+        if (id) local_states = std::make_unique<StateStack>(HISTORY_PLIES + 1 + MAX_PLY);
+    }
+
+    // Only the owner writes the counter; others may read it for reports
+    void add_node() { nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    int id;
+    Board*      board  = nullptr;   // the caller's board for the main thread
+    StateStack* states = nullptr;
+    Board       local_board;
+    std::unique_ptr<StateStack> local_states;
+
+    std::atomic<uint64_t> nodes{0};
+    Move best_move = Move::none();   // from the last completed iteration
+    int  best_score = -VALUE_INFINITE;
+    int  completed_depth = 0;
+
+    // While a null-move verification search runs, `nmp_color` may not
+    // null-move again before ply `nmp_min_ply`
+    int   nmp_min_ply = 0;
+    Color nmp_color = WHITE;
+
+    // Quiet-move ordering, kept across searches and aged rather than wiped
+    std::unique_ptr<MoveHistory> history = std::make_unique<MoveHistory>();
+
+    // Move played at each ply of the current line, none for a null move;
+    // the countermove lookup needs the one that led to the node
+    Move current_move[MAX_PLY + 1];
+
+    // Pool worker (helpers only), parked on `cv` between searches
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool searching = false;
+    bool exit = false;
+
+    void start() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            searching = true;
+        }
+        cv.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return !searching; });
+    }
+
+    // Static eval of each node on the current line, -VALUE_INFINITE when
+    // in check; compared two plies back to tell if the side is improving
+    int static_eval[MAX_PLY + 1];
+
+    // Triangular PV: pv[ply] is the best line found from that ply, only
+    // maintained in PV nodes
+    struct PvLine {
+        int  length;
+        Move moves[MAX_PLY];
+    };
+    std::unique_ptr<PvLine[]> pv = std::make_unique<PvLine[]>(MAX_PLY + 1);
+
+    // A quiet move refuted the node: it becomes a killer and the
+    // countermove, and gains history while the quiets tried before it lose
+    void update_quiet_stats(const Board& board, int ply, int depth, Move m,
+                            const Move* tried, int tried_count) {
+        Color us = board.side_to_move();
+        int bonus = std::min(16 * depth * depth, 1600);
+        history->add_killer(ply, m);
+        history->update(us, m, bonus);
+        for (int i = 0; i < tried_count; ++i)
+            history->update(us, tried[i], -bonus);
+        if (ply > 0) {
+            Move prev = current_move[ply - 1];
+            if (prev) history->countermoves[board.piece_on(prev.to())][prev.to()] = m;
+        }
+    }
+
+    Move countermove(const Board& board, int ply) const {
+        Move prev = ply > 0 ? current_move[ply - 1] : Move::none();
+        return prev ? history->countermoves[board.piece_on(prev.to())][prev.to()] : Move::none();
+    }
+
+    void update_pv(int ply, Move m) {
+        PvLine& line = pv[ply];
+        const PvLine& child = pv[ply + 1];
+        line.moves[0] = m;
+        std::copy(child.moves, child.moves + child.length, line.moves + 1);
+        line.length = child.length + 1;
+    }
+
+    // Sets up a helper on a copy of the root. The states back to the last
+    // irreversible move come along, relinked, so repetitions of positions
+    // played before the root are still seen.
+    void copy_root(const Board& root) {
+        const StateInfo* chain[HISTORY_PLIES + 1];
+        int end = std::min({root.halfmove_clock(), root.state()->plies_from_null, HISTORY_PLIES});
+        int n = 0;
+        for (const StateInfo* si = root.state(); si && n <= end; si = si->previous)
+            chain[n++] = si;
+
+        local_states->clear();
+        for (int k = n - 1; k >= 0; --k) {
+            StateInfo& si = local_states->push();
+            si = *chain[k];
+            si.previous = k == n - 1 ? nullptr : &si - 1;
+            si.plies_from_null = std::min(si.plies_from_null, n - 1 - k);
         }
+        local_board = root;
+        local_board.set_state(&local_states->top());
+        board = &local_board;
+        states = local_states.get();
     }
-    return false;
+};
+
+Searcher::Searcher(size_t hash_mb) : tt_(hash_mb), stop_flag_(false) {
+    threads_.push_back(std::make_unique<Thread>(0));
+    timer_ = std::thread([this] { watchdog(); });
 }
 
-// MVV-LVA scoring for captures
-static int mvv_lva_score(const Board& board, Move m) {
-    if (!m.is_capture()) return 0;
-    PieceType victim = piece_type(board.piece_on(m.to()));
-    PieceType attacker = piece_type(board.piece_on(m.from()));
-    if (m.flags() == EP_CAPTURE) victim = PAWN;
-    return pst::PieceValue[victim] * 10 - pst::PieceValue[attacker];
+Searcher::~Searcher() {
+    set_threads(1);
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        timer_exit_ = true;
+    }
+    timer_cv_.notify_all();
+    timer_.join();
 }
 
-void Searcher::order_moves(const Board& board, MoveList& moves, Move tt_move) {
-    int scores[256];
-    for (int i = 0; i < moves.count; ++i) {
-        if (moves.moves[i] == tt_move) {
-            scores[i] = 1000000; // TT move first
-        } else if (moves.moves[i].is_capture()) {
-            scores[i] = 100000 + mvv_lva_score(board, moves.moves[i]);
-        } else if (moves.moves[i].is_promotion()) {
-            scores[i] = 90000;
-        } else {
-            scores[i] = 0;
+void Searcher::set_threads(int n) {
+    n = std::clamp(n, 1, MAX_THREADS);
+    while (int(threads_.size()) > n) {
+        Thread& th = *threads_.back();
+        {
+            std::lock_guard<std::mutex> lock(th.mutex);
+            th.exit = true;
         }
+        th.cv.notify_all();
+        th.worker.join();
+        threads_.pop_back();
     }
+    while (int(threads_.size()) < n) {
+        threads_.push_back(std::make_unique<Thread>(int(threads_.size())));
+        Thread* th = threads_.back().get();
+        th->worker = std::thread([this, th] { idle_loop(*th); });
+    }
+}
 
-    // Simple selection sort (good enough for ~30 moves)
-    for (int i = 0; i < moves.count - 1; ++i) {
-        int best = i;
-        for (int j = i + 1; j < moves.count; ++j) {
-            if (scores[j] > scores[best]) best = j;
-        }
-        if (best != i) {
-            std::swap(moves.moves[i], moves.moves[best]);
-            std::swap(scores[i], scores[best]);
+// A helper's whole life: wait for a search, run it, report back
+void Searcher::idle_loop(Thread& th) {
+    std::unique_lock<std::mutex> lock(th.mutex);
+    while (true) {
+        th.cv.wait(lock, [&th] { return th.searching || th.exit; });
+        if (th.exit) return;
+
+        lock.unlock();
+        run_thread(th, *limits_);
+        lock.lock();
+
+        th.searching = false;
+        th.cv.notify_all();
+    }
+}
+
+uint64_t Searcher::nodes() const {
+    uint64_t n = 0;
+    for (int i = 0; i < active_threads_; ++i)
+        n += threads_[i]->nodes.load(std::memory_order_relaxed);
+    return n;
+}
+
+void Searcher::arm() {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    armed_ = true;
+    stop_pending_ = ponderhit_pending_ = false;
+}
+
+void Searcher::stop() {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    if (searching_) stop_flag_.store(true);
+    else if (armed_) stop_pending_ = true;
+    timer_cv_.notify_all();
+}
+
+void Searcher::ponderhit() {
+    std::lock_guard<std::mutex> lock(timer_mutex_);
+    if (searching_) time_.ponderhit();
+    else if (armed_) ponderhit_pending_ = true;
+    timer_cv_.notify_all();
+}
+
+// Between searches, and while a search has no deadline (infinite, or
+// pondering until a ponderhit sets one) or is already stopping, this
+// sleeps until notified; otherwise until the hard limit. The deadline is
+// checked again on waking, as the search it belonged to may be over.
+void Searcher::watchdog() {
+    std::unique_lock<std::mutex> lock(timer_mutex_);
+    while (!timer_exit_) {
+        if (!searching_ || !time_.limited() || should_stop()) {
+            timer_cv_.wait(lock);
+        } else if (timer_cv_.wait_until(lock, time_.hard_deadline()) == std::cv_status::timeout
+                   && searching_ && time_.limited()
+                   && TimeManager::Clock::now() >= time_.hard_deadline()) {
+            stop_flag_.store(true);
         }
     }
 }
 
-int Searcher::quiescence(Board& board, int alpha, int beta, int ply,
-                         std::deque<StateInfo>& states) {
-    ++nodes_;
+template<bb::SliderBackend B>
+int Searcher::quiescence(Thread& th, int alpha, int beta, int ply) {
+    Board& board = *th.board;
+    StateStack& states = *th.states;
+    th.add_node();
+
+    if (ply >= MAX_PLY - 1) return evaluate<B>(board);
 
-    int stand_pat = evaluate(board);
+    int stand_pat = evaluate<B>(board);
     if (stand_pat >= beta) return beta;
     if (stand_pat > alpha) alpha = stand_pat;
 
-    MoveList moves;
-    generate_legal_captures(board, moves);
-    order_moves(board, moves, Move::none());
-
-    StateInfo* prev_state = board.state();
-    size_t si = states.size();
-    states.emplace_back();
+    // Captures that lose material by SEE are not even tried
+    MovePicker<B> picker(board, Move::none(), true);
+    StateInfo& st = states.push();
 
-    for (int i = 0; i < moves.count; ++i) {
+    Move m;
+    while ((m = picker.next_move())) {
         if (should_stop()) break;
 
-        board.make_move(moves.moves[i], states[si]);
-        int score = -quiescence(board, -beta, -alpha, ply + 1, states);
-        board.undo_move(moves.moves[i]);
-        board.set_state(prev_state);
+        // Delta pruning: the captured piece cannot lift the score to alpha
+        if (!m.is_promotion()) {
+            PieceType victim = m.flags() == EP_CAPTURE ? PAWN : piece_type(board.piece_on(m.to()));
+            if (stand_pat + pst::PieceValue[victim] + params_.delta_margin <= alpha) continue;
+        }
+
+        board.make_move<B>(m, st);
+        int score = -quiescence<B>(th, -beta, -alpha, ply + 1);
+        board.undo_move(m);
 
         if (score >= beta) {
-            states.pop_back();
+            states.pop();
             return beta;
         }
         if (score > alpha) alpha = score;
     }
 
-    states.pop_back();
+    states.pop();
     return alpha;
 }
 
-int Searcher::alpha_beta(Board& board, int alpha, int beta, int depth, int ply,
-                         std::deque<StateInfo>& states) {
+// PV nodes are searched with an open window and keep the PV; everything
+// else gets a null window (beta == alpha + 1). After the first move of a PV
+// node, the rest are tried with a null window and only re-searched as PV
+// if they beat alpha.
+template<Searcher::NodeType NT, bb::SliderBackend B>
+int Searcher::alpha_beta(Thread& th, int alpha, int beta, int depth, int ply) {
+    constexpr bool pv_node = NT == PV;
+    Board& board = *th.board;
+    StateStack& states = *th.states;
+
+    if constexpr (pv_node) th.pv[ply].length = 0;
+
     if (should_stop()) return 0;
 
-    // Check transposition table
+    // A repetition inside the search tree, or a third occurrence, is a draw.
+    // Tested before the TT, whose scores do not depend on the path.
+    if (board.is_repetition(ply)) return VALUE_DRAW;
+
+    // The side to move can repeat a position: it scores at least a draw
+    if (alpha < VALUE_DRAW && board.upcoming_repetition(ply)) {
+        alpha = VALUE_DRAW;
+        if (alpha >= beta) return alpha;
+    }
+
+    // Check transposition table. PV nodes take only the move, so the PV
+    // is always searched out.
     TTEntry tt_entry;
     Move tt_move = Move::none();
     if (tt_.probe(board.hash(), tt_entry)) {
         tt_move = tt_entry.get_move();
-        if (tt_entry.depth >= depth) {
-            int tt_score = tt_entry.score;
+        if (!pv_node && tt_entry.depth >= depth) {
+            int tt_score = score_from_tt(tt_entry.score, ply);
             if (tt_entry.flag == TT_EXACT) return tt_score;
             if (tt_entry.flag == TT_ALPHA && tt_score <= alpha) return alpha;
             if (tt_entry.flag == TT_BETA && tt_score >= beta) return beta;
@@ -114,127 +328,391 @@ int Searcher::alpha_beta(Board& board, int alpha, int beta, int depth, int ply,
     }
 
     if (depth <= 0) {
-        return quiescence(board, alpha, beta, ply, states);
+        return quiescence<B>(th, alpha, beta, ply);
     }
 
-    ++nodes_;
+    th.add_node();
 
-    MoveList moves;
-    generate_legal_moves(board, moves);
+    if (ply >= MAX_PLY - 1) return evaluate<B>(board);
 
-    // Checkmate or stalemate
-    if (moves.count == 0) {
-        if (board.in_check())
-            return -VALUE_MATE + ply; // Checkmate
-        return VALUE_DRAW; // Stalemate
+    // Draw by 50-move rule, unless the side to move is already mated
+    if (board.halfmove_clock() >= 100) {
+        MoveList moves;
+        generate_legal<ALL_MOVES, B>(board, moves);
+        return (moves.count == 0 && board.in_check()) ? -VALUE_MATE + ply : VALUE_DRAW;
+    }
+
+    // Neither side has mating material left: nothing to search
+    if (material::probe(board)->dead_draw) return VALUE_DRAW;
+
+    bool in_check = board.in_check();
+    Color us = board.side_to_move();
+    const SearchParams& p = params_;
+
+    // The static eval is computed once here for all the pruning below
+    int eval = in_check ? -VALUE_INFINITE : evaluate<B>(board);
+    th.static_eval[ply] = eval;
+    bool improving = !in_check && ply >= 2 && eval > th.static_eval[ply - 2];
+
+    // Reverse futility: far enough above beta that no reply should bring
+    // the score back down
+    if (!pv_node && !in_check && depth <= p.rfp_depth && !is_mate_score(beta)
+        && eval - p.rfp_margin * (depth - improving) >= beta)
+        return beta;
+
+    // Razoring: far below alpha, only a capture could help
+    if (!pv_node && !in_check && depth <= p.razor_depth
+        && eval + p.razor_margin * depth <= alpha) {
+        int score = quiescence<B>(th, alpha, beta, ply);
+        if (score <= alpha) return alpha;
     }
 
-    // Draw by 50-move rule
-    if (board.halfmove_clock() >= 100) return VALUE_DRAW;
+    // Null move: if passing still fails high after a reduced search, a real
+    // move almost surely would. Not in check, never twice in a row, and only
+    // with pieces besides pawns, where zugzwang is rare. Deep cutoffs are
+    // verified by a reduced search with null moves off for this side.
+    if (!pv_node && !in_check && depth >= 3
+        && board.state()->plies_from_null > 0
+        && !is_mate_score(beta)
+        && (board.pieces(us) & ~board.pieces(PAWN, KING))
+        && (ply >= th.nmp_min_ply || us != th.nmp_color)) {
+        if (eval >= beta) {
+            int r = 3 + depth / 4 + std::min((eval - beta) / 200, 3);
+
+            StateInfo& null_st = states.push();
+            th.current_move[ply] = Move::none();
+            board.make_null_move<B>(null_st);
+            int score = -alpha_beta<NON_PV, B>(th, -beta, -beta + 1, depth - r, ply + 1);
+            board.undo_null_move();
+            states.pop();
+
+            if (stop_flag_.load(std::memory_order_relaxed)) return 0;
+
+            if (score >= beta) {
+                if (depth < 12 || th.nmp_min_ply) return beta;
+
+                th.nmp_min_ply = ply + 3 * (depth - r) / 4;
+                th.nmp_color = us;
+                int verified = alpha_beta<NON_PV, B>(th, beta - 1, beta, depth - r, ply);
+                th.nmp_min_ply = 0;
+
+                if (verified >= beta) return beta;
+            }
+        }
+    }
 
-    order_moves(board, moves, tt_move);
+    MovePicker<B> picker(board, tt_move, *th.history, th.history->killers[ply],
+                      th.countermove(board, ply));
 
-    Move best_move = moves.moves[0];
+    Move best_move = Move::none();
     TTFlag flag = TT_ALPHA;
+    int move_count = 0;
+    Move quiets_tried[64];
+    int quiet_count = 0;
+
+    // Quiet moves may be pruned once a move has been searched, as long as
+    // that cannot turn a mate into a false score
+    bool prune_quiets = !in_check && !is_mate_score(alpha);
+    int lmp_count = (p.lmp_base + depth * depth) / (improving ? 1 : 2);
+
+    StateInfo& st = states.push();
+
+    Move m;
+    while ((m = picker.next_move())) {
+        if (!best_move) best_move = m;
+        ++move_count;
+
+        bool quiet = !m.is_capture() && !m.is_promotion();
+        bool gives_check = quiet && board.gives_check<B>(m);   // only quiets need it
+
+        // Late quiet moves are searched shallower first, and again at full
+        // depth only if they beat alpha
+        int r = 0;
+        if (move_count > 1 && depth >= 3 && !in_check && quiet && !gives_check) {
+            r = Reductions[std::min(depth, 63)][std::min(move_count, 63)];
+            if (pv_node) --r;
+            r = std::clamp(r, 0, depth - 2);
+        }
 
-    StateInfo* prev_state = board.state();
-    size_t si = states.size();
-    states.emplace_back();
+        if (quiet && prune_quiets && move_count > 1 && !gives_check) {
+            // Late-move-count pruning: the quiets this late rarely matter
+            if (!pv_node && depth <= p.lmp_depth && quiet_count >= lmp_count) continue;
 
-    for (int i = 0; i < moves.count; ++i) {
-        board.make_move(moves.moves[i], states[si]);
-        int score = -alpha_beta(board, -beta, -alpha, depth - 1, ply + 1, states);
-        board.undo_move(moves.moves[i]);
-        board.set_state(prev_state);
+            // Futility: a quiet move cannot close this gap
+            if (depth <= p.futility_depth
+                && eval + p.futility_margin + p.futility_depth_margin * depth <= alpha)
+                continue;
+        }
+
+        tt_.prefetch(board.key_after(m));
+        th.current_move[ply] = m;
+        board.make_move<B>(m, st);
+        int score;
+        if (move_count == 1) {
+            score = -alpha_beta<NT, B>(th, -beta, -alpha, depth - 1, ply + 1);
+        } else {
+            score = -alpha_beta<NON_PV, B>(th, -alpha - 1, -alpha, depth - 1 - r, ply + 1);
+            if (r && score > alpha)
+                score = -alpha_beta<NON_PV, B>(th, -alpha - 1, -alpha, depth - 1, ply + 1);
+            if (pv_node && score > alpha && score < beta)
+                score = -alpha_beta<PV, B>(th, -beta, -alpha, depth - 1, ply + 1);
+        }
+        board.undo_move(m);
 
         if (stop_flag_.load(std::memory_order_relaxed)) {
-            states.pop_back();
+            states.pop();
             return 0;
         }
 
         if (score >= beta) {
-            tt_.store(board.hash(), beta, depth, TT_BETA, moves.moves[i]);
-            states.pop_back();
+            if (quiet) th.update_quiet_stats(board, ply, depth, m, quiets_tried, quiet_count);
+            tt_.store(board.hash(), score_to_tt(beta, ply), depth, TT_BETA, m);
+            states.pop();
             return beta;
         }
         if (score > alpha) {
             alpha = score;
-            best_move = moves.moves[i];
+            best_move = m;
             flag = TT_EXACT;
+            if constexpr (pv_node) th.update_pv(ply, m);
         }
+        if (quiet && quiet_count < 64) quiets_tried[quiet_count++] = m;
     }
 
-    tt_.store(board.hash(), alpha, depth, flag, best_move);
-    states.pop_back();
+    states.pop();
+
+    // Checkmate or stalemate
+    if (move_count == 0)
+        return board.in_check() ? -VALUE_MATE + ply : VALUE_DRAW;
+
+    tt_.store(board.hash(), score_to_tt(alpha, ply), depth, flag, best_move);
     return alpha;
 }
 
-Move Searcher::search(Board& board, const SearchLimits& limits,
-                      std::deque<StateInfo>& states,
-                      InfoCallback on_info) {
-    stop_flag_.store(false);
-    nodes_ = 0;
-    start_time_ = now_ms();
-    time_limit_ = limits.time_ms;
-    info_cb_ = on_info;
+// One pass over the root moves with the window (alpha, beta), PVS as in
+// alpha_beta. The best move is moved to the front of `moves` for the next
+// pass; the return value is fail-hard like alpha_beta's.
+template<bb::SliderBackend B>
+int Searcher::search_root(Thread& th, MoveList& moves, int alpha, int beta, int depth) {
+    Board& board = *th.board;
+    StateStack& states = *th.states;
+    th.pv[0].length = 0;
+    th.static_eval[0] = board.in_check() ? -VALUE_INFINITE : evaluate<B>(board);
 
-    Move best_move = Move::none();
+    StateInfo& st = states.push();
 
-    // Iterative deepening
-    for (int depth = 1; depth <= limits.max_depth; ++depth) {
-        int alpha = -VALUE_INFINITE;
-        int beta = VALUE_INFINITE;
+    for (int i = 0; i < moves.count; ++i) {
+        Move m = moves.moves[i];
+        tt_.prefetch(board.key_after(m));
+        th.current_move[0] = m;
+        board.make_move<B>(m, st);
+        int score;
+        if (i == 0) {
+            score = -alpha_beta<PV, B>(th, -beta, -alpha, depth - 1, 1);
+        } else {
+            score = -alpha_beta<NON_PV, B>(th, -alpha - 1, -alpha, depth - 1, 1);
+            if (score > alpha && score < beta)
+                score = -alpha_beta<PV, B>(th, -beta, -alpha, depth - 1, 1);
+        }
+        board.undo_move(m);
 
-        MoveList moves;
-        generate_legal_moves(board, moves);
-        if (moves.count == 0) break;
+        if (stop_flag_.load(std::memory_order_relaxed)) break;
+
+        if (score > alpha) {
+            th.update_pv(0, m);
+            std::rotate(moves.moves, moves.moves + i, moves.moves + i + 1);
+            if (score >= beta) {
+                alpha = beta;
+                break;
+            }
+            alpha = score;
+        }
+    }
 
-        // Get TT move for ordering
-        TTEntry tt_entry;
-        Move tt_move = Move::none();
-        if (tt_.probe(board.hash(), tt_entry))
-            tt_move = tt_entry.get_move();
-        order_moves(board, moves, tt_move);
+    states.pop();
+    return alpha;
+}
 
-        Move iter_best = moves.moves[0];
-        int iter_score = -VALUE_INFINITE;
+// Helper i skips depths in a pattern of its own (period SkipSize, offset
+// SkipPhase), so at any time the threads are spread over a few iterations
+static constexpr int SkipSize[]  = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static constexpr int SkipPhase[] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
 
-        StateInfo* prev_state = board.state();
-        size_t si = states.size();
-        states.emplace_back();
+template<bb::SliderBackend B>
+void Searcher::iterative_deepening(Thread& th, const SearchLimits& limits) {
+    Board& board = *th.board;
 
-        for (int i = 0; i < moves.count; ++i) {
-            board.make_move(moves.moves[i], states[si]);
-            int score = -alpha_beta(board, -beta, -alpha, depth - 1, 1, states);
-            board.undo_move(moves.moves[i]);
-            board.set_state(prev_state);
+    constexpr int ASPIRATION_DELTA = 25;
 
-            if (stop_flag_.load(std::memory_order_relaxed)) break;
+    // The root list is built once, in picker order, and kept across
+    // iterations: search_root moves each pass's best move to the front, so
+    // every iteration starts with the move its aspiration window is
+    // centered on
+    TTEntry tt_entry;
+    Move tt_move = Move::none();
+    if (tt_.probe(board.hash(), tt_entry))
+        tt_move = tt_entry.get_move();
 
-            if (score > iter_score) {
-                iter_score = score;
-                iter_best = moves.moves[i];
-            }
-            if (score > alpha) alpha = score;
+    MoveList moves;
+    MovePicker<B> picker(board, tt_move);
+    for (Move m; (m = picker.next_move()); )
+        moves.push(m);
+    if (moves.count == 0) return;
+
+    for (int depth = 1; depth <= limits.max_depth; ++depth) {
+        if (th.id > 0 && depth > 1) {
+            int i = (th.id - 1) % 20;
+            if (((depth + board.game_ply() + SkipPhase[i]) / SkipSize[i]) % 2) continue;
         }
 
-        states.pop_back();
+        th.history->age();
 
-        if (!stop_flag_.load(std::memory_order_relaxed)) {
-            best_move = iter_best;
-            if (info_cb_) {
-                SearchInfo info{depth, iter_score, best_move, nodes_};
-                info_cb_(info);
+        // Aspiration window around the last score, widened on the failing
+        // side until the score lands inside it
+        int delta = ASPIRATION_DELTA;
+        int alpha = -VALUE_INFINITE;
+        int beta = VALUE_INFINITE;
+        if (depth >= 4 && th.completed_depth && !is_mate_score(th.best_score)) {
+            alpha = std::max(th.best_score - delta, -VALUE_INFINITE);
+            beta = std::min(th.best_score + delta, int(VALUE_INFINITE));
+        }
+
+        int score;
+        while (true) {
+            score = search_root<B>(th, moves, alpha, beta, depth);
+            if (stop_flag_.load(std::memory_order_relaxed)) break;
+
+            if (score <= alpha && alpha > -VALUE_INFINITE) {
+                beta = (alpha + beta) / 2;
+                alpha = std::max(score - delta, -VALUE_INFINITE);
+            } else if (score >= beta && beta < VALUE_INFINITE) {
+                beta = std::min(score + delta, int(VALUE_INFINITE));
+            } else {
+                break;
             }
+            delta += delta / 2;
         }
 
         if (stop_flag_.load(std::memory_order_relaxed)) break;
 
+        th.best_move = moves.moves[0];
+        th.best_score = score;
+        th.completed_depth = depth;
+        if (th.id == 0 && info_cb_) {
+            SearchInfo info{depth, score, th.best_move, nodes(), tt_.hashfull(),
+                            std::vector<Move>(th.pv[0].moves, th.pv[0].moves + th.pv[0].length)};
+            info_cb_(info);
+        }
+
         // If we found a mate, no need to search deeper
-        if (is_mate_score(alpha)) break;
+        if (is_mate_score(score)) break;
+
+        if (th.id == 0) {
+            std::lock_guard<std::mutex> lock(timer_mutex_);
+            // A forced reply needs no time, once depth 1 has a score for it
+            if (moves.count == 1 && time_.limited()) break;
+            if (time_.iteration_done(th.best_move, score)) break;
+        }
+    }
+}
+
+void Searcher::run_thread(Thread& th, const SearchLimits& limits) {
+    bb::with_slider_backend([&]<bb::SliderBackend B> { iterative_deepening<B>(th, limits); });
+}
+
+// Each thread votes for its move with weight growing with its score margin
+// over the worst thread and with the depth it completed. A found mate wins
+// outright.
+Move Searcher::vote() const {
+    const Thread* best = threads_[0].get();
+    if (active_threads_ == 1 || !best->best_move) return best->best_move;
+
+    int min_score = best->best_score;
+    for (int i = 1; i < active_threads_; ++i)
+        if (threads_[i]->best_move)
+            min_score = std::min(min_score, threads_[i]->best_score);
+
+    std::vector<std::pair<Move, int64_t>> votes;
+    auto votes_for = [&](Move m) -> int64_t& {
+        for (auto& v : votes)
+            if (v.first == m) return v.second;
+        return votes.emplace_back(m, 0).second;
+    };
+    for (int i = 0; i < active_threads_; ++i) {
+        const Thread& th = *threads_[i];
+        if (th.best_move)
+            votes_for(th.best_move) += int64_t(th.best_score - min_score + 14) * th.completed_depth;
+    }
+
+    for (int i = 1; i < active_threads_; ++i) {
+        const Thread* th = threads_[i].get();
+        if (!th->best_move) continue;
+        if (is_mate_score(best->best_score)
+                ? th->best_score > best->best_score
+                : th->best_score >= MATE_IN_MAX_PLY
+                  || votes_for(th->best_move) > votes_for(best->best_move))
+            best = th;
+    }
+    return best->best_move;
+}
+
+Move Searcher::search(Board& board, const SearchLimits& limits,
+                      StateStack& states,
+                      InfoCallback on_info) {
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        time_.init(limits, board.side_to_move());
+        if (ponderhit_pending_) time_.ponderhit();
+        stop_flag_.store(stop_pending_);
+        stop_pending_ = ponderhit_pending_ = false;
+        armed_ = false;
+        searching_ = true;
+    }
+    timer_cv_.notify_all();
+    info_cb_ = on_info;
+    limits_ = &limits;
+    tt_.new_search();
+
+    active_threads_ = std::clamp(limits.threads, 1, MAX_THREADS);
+    if (active_threads_ > threads()) set_threads(active_threads_);
+
+    for (int i = 0; i < active_threads_; ++i) {
+        Thread& th = *threads_[i];
+        th.nodes.store(0, std::memory_order_relaxed);
+        th.best_move = Move::none();
+        th.best_score = -VALUE_INFINITE;
+        th.completed_depth = 0;
+        std::fill(&th.history->killers[0][0], &th.history->killers[MAX_PLY][2], Move::none());
+        if (i == 0) {
+            th.board = &board;
+            th.states = &states;
+        } else {
+            th.copy_root(board);
+        }
+    }
+
+    for (int i = 1; i < active_threads_; ++i)
+        threads_[i]->start();
+
+    run_thread(*threads_[0], limits);
+
+    // A ponder search holds its move back until ponderhit() or stop(),
+    // however early it finished
+    {
+        std::unique_lock<std::mutex> lock(timer_mutex_);
+        timer_cv_.wait(lock, [this] { return !time_.pondering() || should_stop(); });
+    }
+
+    stop_flag_.store(true);
+    for (int i = 1; i < active_threads_; ++i)
+        threads_[i]->wait();
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex_);
+        searching_ = false;
     }
+    timer_cv_.notify_all();
 
-    return best_move;
+    return vote();
 }
 
 } // namespace chess
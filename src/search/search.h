@@ -3,17 +3,29 @@
 #include "../core/board.h"
 #include "../core/move.h"
 #include "../core/movegen.h"
+#include "timeman.h"
 #include "ttable.h"
 #include <atomic>
+#include <condition_variable>
 #include <functional>
-#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace chess {
 
+// With a clock for the side to move (wtime or btime > 0) the TimeManager
+// budgets the move from it; otherwise time_ms is a fixed move time
 struct SearchLimits {
     int max_depth = 64;
-    int time_ms = 5000;   // milliseconds
+    int time_ms = 5000;       // fixed move time, milliseconds
+    int wtime = 0, btime = 0; // time left on each clock, milliseconds
+    int winc = 0, binc = 0;   // increment per move, milliseconds
+    int movestogo = 0;        // moves until the next time control; 0 = rest of the game
+    bool infinite = false;    // no time limit; only stop() or max_depth ends the search
+    bool ponder = false;      // no time limit until ponderhit(), then the ones above
+    int threads = 1;          // search threads, main included; 0 = the Engine's setting
 };
 
 struct SearchInfo {
@@ -21,37 +33,132 @@ struct SearchInfo {
     int score;
     Move best_move;
     uint64_t nodes;
+    int hashfull;   // permille of the TT used by this search
+    std::vector<Move> pv;
 };
 
 using InfoCallback = std::function<void(const SearchInfo&)>;
 
+// Margins for the pruning near the leaves, in centipawns unless noted.
+// Pruning applies at `*_depth` plies from the horizon and below.
+struct SearchParams {
+    // Reverse futility: the static eval beats beta by margin * depth
+    int rfp_depth  = 8;
+    int rfp_margin = 80;
+
+    // Razoring: the static eval is so far below alpha that only captures
+    // can help, so the node drops into quiescence
+    int razor_depth  = 2;
+    int razor_margin = 250;   // times depth
+
+    // Futility: a quiet move is skipped when the static eval plus the
+    // margin still cannot reach alpha
+    int futility_depth        = 6;
+    int futility_margin       = 100;
+    int futility_depth_margin = 100;   // added per ply of depth
+
+    // Late-move-count pruning: after lmp_base + depth^2 quiets (half that
+    // when the eval is not improving) the rest are skipped
+    int lmp_depth = 6;
+    int lmp_base  = 3;
+
+    // Delta pruning in quiescence: a capture is skipped when even winning
+    // the piece with this much to spare leaves the score below alpha
+    int delta_margin = 200;
+};
+
+// Lazy SMP: the main thread and limits.threads - 1 helpers search the same
+// root independently, sharing only the transposition table. The helpers
+// are a pool of workers that stay parked between searches. Helpers skip
+// some depths so they spread over different iterations, and the final move
+// is voted on by all of them.
 class Searcher {
 public:
-    Searcher();
+    static constexpr int MAX_THREADS = 256;
+    static constexpr size_t DEFAULT_HASH_MB = 64;
+
+    explicit Searcher(size_t hash_mb = DEFAULT_HASH_MB);
+    ~Searcher();
 
+    // `states` must have room for MAX_PLY more entries
     Move search(Board& board, const SearchLimits& limits,
-                std::deque<StateInfo>& states,
+                StateStack& states,
                 InfoCallback on_info = nullptr);
 
-    void stop() { stop_flag_.store(true); }
-    uint64_t nodes() const { return nodes_; }
+    // stop() and ponderhit() act on the running search and are no-ops when
+    // there is none. A caller that starts search() on another thread calls
+    // arm() first: requests made between arm() and the start of that
+    // search are kept for it, so they cannot be lost to the race.
+    // A ponder search keeps going, and search() does not return, until
+    // stop() or ponderhit() is called.
+    void arm();
+    void stop();
+    void ponderhit();
+
+    // Size of the thread pool, main thread included; not during a search.
+    // A search asking for more threads grows the pool first.
+    void set_threads(int n);
+    int threads() const { return int(threads_.size()); }
+    uint64_t nodes() const;
+
+    // Not during a search. False if the size could not be allocated.
+    // Sizing and clearing use the pool's thread count.
+    bool resize_hash(size_t mb) { return tt_.resize(mb, unsigned(threads())); }
+    void clear_hash() { tt_.clear(unsigned(threads())); }
+    size_t hash_mb() const { return tt_.size_mb(); }
+    int hashfull() const { return tt_.hashfull(); }
+
+    // Not during a search
+    SearchParams& params() { return params_; }
 
 private:
-    int alpha_beta(Board& board, int alpha, int beta, int depth, int ply,
-                   std::deque<StateInfo>& states);
-    int quiescence(Board& board, int alpha, int beta, int ply,
-                   std::deque<StateInfo>& states);
-    void order_moves(const Board& board, MoveList& moves, Move tt_move);
+    // Per-thread search state (search.cpp)
+    struct Thread;
+
+    enum NodeType { PV, NON_PV };
+
+    // The search is compiled for each slider backend (bitboard.h);
+    // run_thread picks the instantiation once per search
+    template<NodeType NT, bb::SliderBackend B>
+    int alpha_beta(Thread& th, int alpha, int beta, int depth, int ply);
+    template<bb::SliderBackend B>
+    int search_root(Thread& th, MoveList& moves, int alpha, int beta, int depth);
+    template<bb::SliderBackend B>
+    int quiescence(Thread& th, int alpha, int beta, int ply);
+    template<bb::SliderBackend B>
+    void iterative_deepening(Thread& th, const SearchLimits& limits);
+    void run_thread(Thread& th, const SearchLimits& limits);
+    void idle_loop(Thread& th);
+    Move vote() const;
 
     TranspositionTable tt_;
+    SearchParams params_;
     std::atomic<bool> stop_flag_;
-    uint64_t nodes_;
-    int64_t start_time_;
-    int64_t time_limit_;
+    TimeManager time_;
     InfoCallback info_cb_;
+    const SearchLimits* limits_ = nullptr;   // of the running search, for the helpers
+
+    // threads_[0] is the main thread, which searches on the caller's
+    // thread; the helpers are pool workers kept, with their state stacks
+    // and thread-local caches, across searches
+    std::vector<std::unique_ptr<Thread>> threads_;
+    int active_threads_ = 1;
+
+    // The search never reads the clock: a watchdog thread, alive as long
+    // as the Searcher, sleeps until the hard limit and raises stop_flag_,
+    // and the search only polls the flag. The mutex guards time_ and the
+    // flags below.
+    std::mutex timer_mutex_;
+    std::condition_variable timer_cv_;
+    std::thread timer_;
+    bool timer_exit_ = false;
+    bool searching_ = false;
+    bool armed_ = false;               // arm() called, search() not yet started
+    bool stop_pending_ = false;        // stop() while armed
+    bool ponderhit_pending_ = false;   // likewise for ponderhit()
+    void watchdog();
 
-    static constexpr int CHECK_NODES = 2048;
-    bool should_stop();
+    bool should_stop() const { return stop_flag_.load(std::memory_order_relaxed); }
 };
 
 } // namespace chess
@@ -0,0 +1,64 @@
+#include "timeman.h"
+#include "search.h"
+#include <algorithm>
+
+namespace chess {
+
+void TimeManager::init(const SearchLimits& limits, Color us) {
+    start_ = Clock::now();
+    instability_ = 0;
+    last_best_ = Move::none();
+    last_score_ = 0;
+    iterations_ = 0;
+
+    int64_t time = us == WHITE ? limits.wtime : limits.btime;
+    int64_t inc  = us == WHITE ? limits.winc  : limits.binc;
+
+    infinite_ = limits.infinite;
+    pondering_ = limits.ponder;
+    uses_clock_ = !infinite_ && time > 0;
+    if (!uses_clock_) {
+        soft_ms_ = hard_ms_ = std::max(limits.time_ms, 1);
+        return;
+    }
+
+    // Spread what is left over the moves to go, counting most of the
+    // increment as ours to spend. The hard limit allows a few times that
+    // for the extensions, but never most of the clock.
+    int64_t available = std::max<int64_t>(time - MOVE_OVERHEAD, 1);
+    int mtg = limits.movestogo > 0 ? std::min(limits.movestogo, 50) : DEFAULT_MOVES_TO_GO;
+    int64_t soft = available / mtg + inc * 3 / 4;
+
+    hard_ms_ = std::max<int64_t>(std::min(soft * 5, available * 4 / 5), 1);
+    soft_ms_ = std::min(soft, hard_ms_);
+}
+
+// Time spent pondering is free: the budget runs from the hit
+void TimeManager::ponderhit() {
+    start_ = Clock::now();
+    pondering_ = false;
+}
+
+int64_t TimeManager::elapsed_ms() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_).count();
+}
+
+bool TimeManager::iteration_done(Move best_move, int score) {
+    if (!uses_clock_ || pondering_) return false;
+
+    instability_ /= 2;
+    if (iterations_++ && best_move != last_best_) instability_ += 4;
+    int drop = iterations_ > 1 ? last_score_ - score : 0;
+    last_best_ = best_move;
+    last_score_ = score;
+
+    // Percent of the soft limit to use. The terms add up: +20 per unit of
+    // instability (which settles at 8, so +160, if the best move changes
+    // every iteration) and +1 per centipawn the score dropped, up to +100.
+    // At most 360%, and never past the hard limit.
+    int64_t scale = 100 + 20 * instability_ + std::clamp(drop, 0, 100);
+    int64_t soft = std::min(soft_ms_ * scale / 100, hard_ms_);
+    return elapsed_ms() >= soft;
+}
+
+} // namespace chess
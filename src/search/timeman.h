@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../core/types.h"
+#include "../core/move.h"
+#include <chrono>
+#include <cstdint>
+
+namespace chess {
+
+struct SearchLimits;
+
+// Decides how long a search may run. With a clock (wtime/btime, inc,
+// movestogo) it sets two limits:
+//   soft: no new iteration is started past it. It is stretched while the
+//         best move keeps changing or the score is dropping.
+//   hard: the search is aborted, even in the middle of an iteration.
+// A fixed move time makes both limits equal; an infinite search has none.
+// A ponder search has none either until ponderhit(), which starts the
+// clock on the limits it was given.
+class TimeManager {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Safety margin kept off the clock for move transmission and lag (ms)
+    static constexpr int64_t MOVE_OVERHEAD = 30;
+    // Moves the remaining time is spread over without a movestogo
+    static constexpr int DEFAULT_MOVES_TO_GO = 30;
+
+    void init(const SearchLimits& limits, Color us);
+
+    // False for an infinite search, which only stop() ends, and while pondering
+    bool limited() const { return !infinite_ && !pondering_; }
+    bool pondering() const { return pondering_; }
+    void ponderhit();
+    // Whether the move is budgeted from a clock rather than a fixed move time
+    bool uses_clock() const { return uses_clock_; }
+
+    Clock::time_point hard_deadline() const { return start_ + std::chrono::milliseconds(hard_ms_); }
+    int64_t elapsed_ms() const;
+
+    // Called by the main thread after each completed iteration, with its
+    // best move and score. True when no new iteration should be started.
+    bool iteration_done(Move best_move, int score);
+
+private:
+    Clock::time_point start_;
+    bool    infinite_ = false;
+    bool    pondering_ = false;
+    bool    uses_clock_ = false;
+    int64_t soft_ms_ = 0;
+    int64_t hard_ms_ = 0;
+
+    // Best-move changes, halved each iteration so recent ones weigh most
+    int  instability_ = 0;
+    Move last_best_ = Move::none();
+    int  last_score_ = 0;
+    int  iterations_ = 0;
+};
+
+} // namespace chess
@@ -1,5 +1,172 @@
 #include "ttable.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
-// Implementation is fully in the header (inline/template-like)
-// This file exists for build consistency
-namespace chess {}
+#if defined(__linux__)
+#include <sys/mman.h>
+#ifdef MADV_HUGEPAGE
+#define CHESTRAT_HAS_MADVISE
+#endif
+#endif
+
+namespace chess {
+
+namespace {
+
+constexpr size_t HUGE_PAGE = size_t(2) << 20;
+
+// 2 MB aligned so the kernel can back it with huge pages: with 4 KB pages
+// nearly every probe of a large table is a TLB miss as well as a cache miss
+void* alloc_large(size_t bytes) {
+    size_t size = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    void* p = std::aligned_alloc(HUGE_PAGE, size);
+#ifdef CHESTRAT_HAS_MADVISE
+    if (p) madvise(p, size, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+// Clearing is memory bound: below this many MB a share is not worth a thread
+constexpr size_t MB_PER_THREAD = 64;
+
+} // namespace
+
+// Nothing to destroy: atomic words are trivially destructible
+void TranspositionTable::LargeFree::operator()(Bucket* p) const {
+    static_assert(std::is_trivially_destructible_v<Bucket>);
+    std::free(p);
+}
+
+// Splits the buckets into one contiguous share per thread, capped so that
+// small tables are done on the calling thread alone
+template<typename F>
+void TranspositionTable::parallel_for(unsigned threads, F&& fn) {
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t mb = std::max<size_t>(1, bucket_count_ * sizeof(Bucket) >> 20);
+    threads = unsigned(std::clamp<size_t>(mb / MB_PER_THREAD, 1, threads));
+    size_t chunk = (bucket_count_ + threads - 1) / threads;
+
+    auto share = [&fn, this, chunk](size_t i) {
+        size_t begin = std::min(bucket_count_, i * chunk);
+        size_t end = std::min(bucket_count_, begin + chunk);
+        fn(buckets_.get() + begin, end - begin);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) pool.emplace_back(share, i);
+    share(0);
+    for (auto& t : pool) t.join();
+}
+
+bool TranspositionTable::resize(size_t mb, unsigned threads) {
+    size_t count = std::max<size_t>(1, (std::min(mb, MAX_MB) << 20) / sizeof(Bucket));
+    if (buckets_ && count == bucket_count_) {
+        clear(threads);
+        return true;
+    }
+
+    // Free first, so the old and new tables never have to fit together. If
+    // the new size cannot be had, go back to the old one.
+    size_t old_count = bucket_count_;
+    buckets_.reset();
+    auto* mem = static_cast<Bucket*>(alloc_large(count * sizeof(Bucket)));
+    bool ok = mem != nullptr;
+    if (!ok) {
+        count = std::max<size_t>(1, old_count);
+        mem = static_cast<Bucket*>(alloc_large(count * sizeof(Bucket)));
+        if (!mem) throw std::bad_alloc();
+    }
+    buckets_.reset(mem);
+    bucket_count_ = count;
+
+    // Start the buckets' lifetime; their atomics construct to zero, an
+    // empty entry. Each thread also faults in its own share of the pages.
+    parallel_for(threads, [](Bucket* first, size_t n) {
+        std::uninitialized_default_construct_n(first, n);
+    });
+    generation_ = 0;
+    return ok;
+}
+
+void TranspositionTable::clear(unsigned threads) {
+    parallel_for(threads, [](Bucket* first, size_t n) {
+        for (Bucket* b = first; b != first + n; ++b)
+            for (auto& slot : b->entries) slot.store(0, std::memory_order_relaxed);
+    });
+    generation_ = 0;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) {
+    Bucket& b = bucket(key);
+    for (auto& slot : b.entries) {
+        uint64_t word = slot.load(std::memory_order_relaxed);
+        if (key_check(word) != uint16_t(key) || flag_of(word) == TT_NONE) continue;
+
+        // Still useful: bring it into the current generation
+        if (age(word))
+            slot.store((word & ~(GENERATION_MASK << 58)) | generation_ << 58,
+                       std::memory_order_relaxed);
+
+        entry = decode(word);
+        return true;
+    }
+    return false;
+}
+
+// The slot is the position's own entry if it has one, else an empty one,
+// else the entry with the least depth once each search of age costs it
+// AGE_WEIGHT plies
+void TranspositionTable::store(uint64_t key, int score, int depth, TTFlag flag, Move best) {
+    constexpr int AGE_WEIGHT = 8;
+
+    Bucket& b = bucket(key);
+    std::atomic<uint64_t>* replace = &b.entries[0];
+    int replace_value = INT32_MAX;
+    for (auto& slot : b.entries) {
+        uint64_t word = slot.load(std::memory_order_relaxed);
+        if (key_check(word) == uint16_t(key) || flag_of(word) == TT_NONE) {
+            replace = &slot;
+            break;
+        }
+        int value = depth_of(word) - AGE_WEIGHT * age(word);
+        if (value < replace_value) {
+            replace_value = value;
+            replace = &slot;
+        }
+    }
+
+    uint64_t old = replace->load(std::memory_order_relaxed);
+    bool same = key_check(old) == uint16_t(key) && flag_of(old) != TT_NONE;
+    if (same) {
+        // Keep a deeper exact result from this search over a bound
+        if (flag != TT_EXACT && flag_of(old) == TT_EXACT && depth_of(old) > depth && !age(old))
+            return;
+        // Keep the old move rather than none
+        if (!best) best = decode(old).get_move();
+    }
+
+    uint64_t word = uint64_t(uint16_t(key))
+                  | uint64_t(best.raw()) << 16
+                  | uint64_t(uint16_t(score)) << 32
+                  | uint64_t(std::clamp(depth, 0, 255)) << 48
+                  | uint64_t(flag) << 56
+                  | generation_ << 58;
+    replace->store(word, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+    size_t sample = std::min<size_t>(1000, bucket_count_);
+    int count = 0;
+    for (size_t i = 0; i < sample; ++i)
+        for (const auto& slot : buckets_[i].entries) {
+            uint64_t word = slot.load(std::memory_order_relaxed);
+            count += flag_of(word) != TT_NONE && !age(word);
+        }
+    return int(count * 1000 / (sample * BUCKET_SIZE));
+}
+
+} // namespace chess
@@ -2,8 +2,9 @@
 
 #include "../core/types.h"
 #include "../core/move.h"
-#include <vector>
-#include <cstring>
+#include <atomic>
+#include <cstddef>
+#include <memory>
 
 namespace chess {
 
@@ -14,8 +15,8 @@ enum TTFlag : uint8_t {
     TT_BETA  = 3, // Lower bound (failed high)
 };
 
+// Decoded copy of a table entry, as returned by probe()
 struct TTEntry {
-    uint64_t key;
     int16_t  score;
     int16_t  depth;
     uint8_t  flag;
@@ -29,46 +30,89 @@ struct TTEntry {
     }
 };
 
+// Buckets of four one-word entries, two buckets to a cache line:
+//   bits  0-15 key check (low 16 bits of the Zobrist key)
+//   bits 16-31 move
+//   bits 32-47 score
+//   bits 48-55 depth
+//   bits 56-57 bound, bits 58-63 generation
+// The bucket comes from the high bits of the key (multiply-high, so any
+// table size works without a division), the check from the low bits.
+// Every entry is read and written as a single relaxed 64-bit atomic, so
+// search threads share the table without locks and never see a torn entry.
 class TranspositionTable {
 public:
+    static constexpr int BUCKET_SIZE = 4;
+    static constexpr size_t MAX_MB = size_t(1) << 20;   // 1 TB
+
     TranspositionTable(size_t mb = 64) {
         resize(mb);
     }
 
-    void resize(size_t mb) {
-        size_t bytes = mb * 1024 * 1024;
-        num_entries_ = bytes / sizeof(TTEntry);
-        table_.resize(num_entries_);
-        clear();
-    }
+    // Not while a search is running. The memory is 2 MB aligned and, where
+    // the OS supports it, backed by transparent huge pages. Returns false,
+    // keeping the current table, if the allocation fails.
+    bool resize(size_t mb, unsigned threads = 0);
+
+    // Empties the table. Both spread the work over up to `threads` threads
+    // (0 = all hardware threads), one per 64 MB of table at most.
+    void clear(unsigned threads = 0);
+
+    size_t size_mb() const { return bucket_count_ * sizeof(Bucket) >> 20; }
 
-    void clear() {
-        std::memset(table_.data(), 0, table_.size() * sizeof(TTEntry));
+    // Called once per search: entries from older searches lose priority
+    void new_search() { generation_ = (generation_ + 1) & GENERATION_MASK; }
+
+    // Scores are stored as given; the search converts mate scores to
+    // distances from the node first (search.cpp)
+    bool probe(uint64_t key, TTEntry& entry);
+    void store(uint64_t key, int score, int depth, TTFlag flag, Move best);
+
+    // Permille of a sample of entries written by the current search
+    int hashfull() const;
+
+    // Starts loading the bucket for key, ahead of a probe
+    void prefetch(uint64_t key) const {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(&bucket(key));
+#endif
     }
 
-    bool probe(uint64_t key, TTEntry& entry) const {
-        size_t idx = key % num_entries_;
-        entry = table_[idx];
-        return entry.key == key && entry.flag != TT_NONE;
+private:
+    struct alignas(32) Bucket {
+        std::atomic<uint64_t> entries[BUCKET_SIZE];
+    };
+
+    static constexpr uint64_t GENERATION_MASK = 63;
+
+    static uint16_t key_check(uint64_t word) { return uint16_t(word); }
+    static int      depth_of(uint64_t word) { return int((word >> 48) & 0xFF); }
+    static TTFlag   flag_of(uint64_t word) { return TTFlag((word >> 56) & 3); }
+    static uint64_t generation_of(uint64_t word) { return word >> 58; }
+
+    static TTEntry decode(uint64_t word) {
+        TTEntry e;
+        e.best_move = uint16_t(word >> 16);
+        e.score     = int16_t(word >> 32);
+        e.depth     = int16_t(depth_of(word));
+        e.flag      = flag_of(word);
+        return e;
     }
 
-    void store(uint64_t key, int score, int depth, TTFlag flag, Move best) {
-        size_t idx = key % num_entries_;
-        TTEntry& e = table_[idx];
-        // Always replace (simple scheme)
-        // Prefer deeper entries unless new is exact
-        if (e.key == key && e.depth > depth && flag != TT_EXACT && e.flag == TT_EXACT)
-            return;
-        e.key = key;
-        e.score = int16_t(score);
-        e.depth = int16_t(depth);
-        e.flag = flag;
-        e.best_move = best.raw();
+    int age(uint64_t word) const { return int((generation_ - generation_of(word)) & GENERATION_MASK); }
+
+    Bucket& bucket(uint64_t key) const {
+        return buckets_[size_t((unsigned __int128)key * bucket_count_ >> 64)];
     }
 
-private:
-    std::vector<TTEntry> table_;
-    size_t num_entries_ = 0;
+    struct LargeFree { void operator()(Bucket* p) const; };
+
+    template<typename F>
+    void parallel_for(unsigned threads, F&& fn);
+
+    std::unique_ptr<Bucket[], LargeFree> buckets_;
+    size_t bucket_count_ = 0;
+    uint64_t generation_ = 0;
 };
 
 } // namespace chess
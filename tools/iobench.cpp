@@ -0,0 +1,162 @@
+// chestrat-iobench: throughput of the position file readers.
+//
+//   chestrat-iobench epd <file>     parse every FEN/EPD line into a Board
+//   chestrat-iobench pack <file>    round-trip the same positions through
+//                                   the 32-byte packed format
+//   chestrat-iobench pgn <file> [threads]
+//                                   replay every game through the SAN parser
+//
+// Reports positions/sec and MB/sec; invalid FENs are counted, not fatal.
+
+#include "../src/core/board.h"
+#include "../src/core/packed.h"
+#include "../src/io/epd.h"
+#include "../src/io/pgn.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace chess;
+
+namespace {
+
+void report(const char* what, uint64_t items, size_t bytes, double seconds) {
+    std::printf("%-10s: %llu\n", what, (unsigned long long)items);
+    std::printf("Time (ms) : %.0f\n", seconds * 1000);
+    std::printf("%-10s: %.0f/s\n", what, seconds > 0 ? items / seconds : 0.0);
+    std::printf("Throughput: %.1f MB/s\n", seconds > 0 ? bytes / seconds / (1024 * 1024) : 0.0);
+}
+
+int bench_epd(const std::string& path) {
+    EpdReader reader;
+    if (!reader.open(path)) {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 2;
+    }
+
+    Board board;
+    StateInfo si;
+    board.set_state(&si);
+
+    uint64_t positions = 0, invalid = 0, ops = 0;
+    uint64_t checksum = 0;
+    std::vector<EpdRecord> chunk;
+
+    auto start = std::chrono::steady_clock::now();
+    while (reader.next_chunk(chunk)) {
+        for (const EpdRecord& rec : chunk) {
+            if (board.set_fen(rec.fen) != FenError::NONE) { ++invalid; continue; }
+            ++positions;
+            checksum ^= board.hash();
+            for_each_epd_op(rec.ops, [&](std::string_view, std::string_view) { ++ops; });
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    report("Positions", positions, reader.size(), seconds);
+    std::printf("Invalid   : %llu\n", (unsigned long long)invalid);
+    std::printf("EPD ops   : %llu\n", (unsigned long long)ops);
+    std::printf("Checksum  : %016llx\n", (unsigned long long)checksum);
+    return 0;
+}
+
+int bench_pack(const std::string& path) {
+    EpdReader reader;
+    if (!reader.open(path)) {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 2;
+    }
+
+    Board board;
+    StateInfo si;
+    board.set_state(&si);
+
+    // Load the text once, untimed
+    std::vector<PackedPosition> packed;
+    uint64_t fen_checksum = 0;
+    std::vector<EpdRecord> chunk;
+    while (reader.next_chunk(chunk)) {
+        for (const EpdRecord& rec : chunk) {
+            if (board.set_fen(rec.fen) != FenError::NONE) continue;
+            fen_checksum ^= board.hash();
+            packed.emplace_back();
+            board.pack(packed.back());
+        }
+    }
+
+    // Decode everything, re-encoding each board to check the round trip
+    std::vector<PackedPosition> repacked(packed.size());
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    size_t decoded = unpack_positions(packed.data(), packed.size(), board,
+                                      [&](const Board& b, size_t) { checksum ^= b.hash(); });
+    double decode_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    unpack_positions(packed.data(), packed.size(), board,
+                     [&](const Board& b, size_t i) { b.pack(repacked[i]); });
+    double round_trip_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool same = decoded == packed.size() && checksum == fen_checksum
+             && std::equal(packed.begin(), packed.end(), repacked.begin());
+    size_t bytes = packed.size() * sizeof(PackedPosition);
+
+    std::printf("Text size : %.1f MB\n", reader.size() / (1024.0 * 1024));
+    std::printf("Packed    : %.1f MB\n", bytes / (1024.0 * 1024));
+    report("Decoded", decoded, bytes, decode_s);
+    std::printf("Encode    : %.0f/s (decode + encode minus decode)\n",
+                round_trip_s > decode_s ? decoded / (round_trip_s - decode_s) : 0.0);
+    std::printf("Round trip: %s\n", same ? "ok" : "MISMATCH");
+    return same ? 0 : 1;
+}
+
+int bench_pgn(const std::string& path, int threads) {
+    PgnReader reader;
+    if (!reader.open(path)) {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return 2;
+    }
+
+    // Per-thread checksums, so the callback needs no synchronization
+    std::vector<uint64_t> checksums(threads);
+    auto start = std::chrono::steady_clock::now();
+    PgnStats stats = reader.replay(threads, [&](const Board& board, Move m, int thread) {
+        checksums[thread] ^= board.hash() + m.raw();
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t checksum = 0;
+    for (uint64_t c : checksums) checksum ^= c;
+
+    report("Moves", stats.moves, reader.size(), seconds);
+    std::printf("Games     : %llu (%llu bad)\n", (unsigned long long)stats.games,
+                (unsigned long long)stats.bad_games);
+    std::printf("Threads   : %d\n", threads);
+    std::printf("Checksum  : %016llx\n", (unsigned long long)checksum);
+    return 0;
+}
+
+void usage() {
+    std::fprintf(stderr, "usage: chestrat-iobench epd|pack <file>\n"
+                         "       chestrat-iobench pgn <file> [threads]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bb::init();
+
+    if (argc < 3) { usage(); return 2; }
+    std::string mode = argv[1];
+    if (mode == "pgn") return bench_pgn(argv[2], argc > 3 ? std::max(1, std::atoi(argv[3])) : 1);
+    if (argc != 3) { usage(); return 2; }
+    if (mode == "epd") return bench_epd(argv[2]);
+    if (mode == "pack") return bench_pack(argv[2]);
+
+    usage();
+    return 2;
+}
@@ -0,0 +1,284 @@
+// chestrat-perft: move generator correctness and speed gate.
+//
+//   chestrat-perft [options] <depth> [fen]
+//   chestrat-perft [options] --epd <file> [--depth N]
+//
+// Options:
+//   --divide        print the node count under each root move
+//   --threads N     worker threads for the root split (default: all cores)
+//   --hash MB       perft hash size, 0 to disable (default: 64)
+//
+// EPD lines are "<fen> ;D1 <count> ;D2 <count> ...". Every depth listed is
+// checked, up to --depth if given; the exit status is 1 if any count is off.
+
+#include "../src/core/board.h"
+#include "../src/core/movegen.h"
+#include "../src/io/epd.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace chess;
+
+namespace {
+
+// ── Perft hash ──────────────────────────────────────────────────────────
+// Shared by all workers without locks. An entry is two relaxed 64-bit
+// words: data = count << 8 | depth, and key ^ data. A torn write from two
+// threads racing on the same slot fails the XOR check and reads as a miss.
+class PerftHash {
+public:
+    explicit PerftHash(size_t mb) {
+        size_t n = 1;
+        while (n * 2 * sizeof(Entry) <= mb * 1024 * 1024) n *= 2;
+        if (mb == 0) return;
+        entries_ = std::make_unique<Entry[]>(n);
+        mask_ = n - 1;
+    }
+
+    bool probe(uint64_t key, int depth, uint64_t& count) const {
+        if (!entries_) return false;
+        const Entry& e = entries_[key & mask_];
+        uint64_t data = e.data.load(std::memory_order_relaxed);
+        uint64_t check = e.key_xor_data.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || int(data & 0xFF) != depth) return false;
+        count = data >> 8;
+        return true;
+    }
+
+    void store(uint64_t key, int depth, uint64_t count) {
+        if (!entries_) return;
+        Entry& e = entries_[key & mask_];
+        uint64_t data = (count << 8) | uint64_t(depth);
+        e.data.store(data, std::memory_order_relaxed);
+        e.key_xor_data.store(key ^ data, std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> key_xor_data{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    std::unique_ptr<Entry[]> entries_;
+    size_t mask_ = 0;
+};
+
+template<bb::SliderBackend B>
+uint64_t hashed_perft(Board& board, int depth, StateStack& states, PerftHash& hash) {
+    MoveList moves;
+    generate_legal<ALL_MOVES, B>(board, moves);
+
+    // Bulk counting: the last ply is just the size of the move list
+    if (depth == 1) return moves.count;
+
+    uint64_t nodes = 0;
+    if (hash.probe(board.hash(), depth, nodes)) return nodes;
+
+    StateInfo& st = states.push();
+    for (Move m : moves) {
+        board.make_move<B>(m, st);
+        nodes += hashed_perft<B>(board, depth - 1, states, hash);
+        board.undo_move(m);
+    }
+    states.pop();
+
+    hash.store(board.hash(), depth, nodes);
+    return nodes;
+}
+
+// ── Root split ──────────────────────────────────────────────────────────
+// Workers take root moves from a shared counter, each on its own copy of
+// the board and its own state stack.
+struct RootResult {
+    Move     move;
+    uint64_t nodes;
+};
+
+std::vector<RootResult> perft_divide(const Board& root, int depth, int threads,
+                                     PerftHash& hash) {
+    MoveList moves;
+    generate_legal_moves(root, moves);
+
+    std::vector<RootResult> results(moves.count);
+    for (int i = 0; i < moves.count; ++i) results[i] = {moves.moves[i], 1};
+    if (depth == 1) return results;
+
+    std::atomic<int> next{0};
+    auto worker = [&] {
+        Board board = root;
+        StateStack states(MAX_PLY);
+        StateInfo& st0 = states.push();
+        st0 = *root.state();
+        st0.previous = nullptr;
+        board.set_state(&st0);
+
+        for (int i; (i = next.fetch_add(1)) < moves.count; ) {
+            StateInfo& st = states.push();
+            board.make_move(results[i].move, st);
+            results[i].nodes = bb::with_slider_backend([&]<bb::SliderBackend B> {
+                return hashed_perft<B>(board, depth - 1, states, hash);
+            });
+            board.undo_move(results[i].move);
+            states.pop();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    int n = std::max(1, std::min(threads, moves.count));
+    for (int t = 1; t < n; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+
+    return results;
+}
+
+// ── Driver ──────────────────────────────────────────────────────────────
+struct Options {
+    bool        divide  = false;
+    int         threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    size_t      hash_mb = 64;
+    int         depth   = 0;
+    std::string fen     = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    std::string epd;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool run_position(std::string_view fen, int depth, const Options& opt,
+                  PerftHash& hash, uint64_t& total, double& elapsed) {
+    Board board;
+    StateInfo si;
+    board.set_state(&si);
+    if (FenError err = board.set_fen(fen); err != FenError::NONE) {
+        std::fprintf(stderr, "invalid FEN (%s): %.*s\n", fen_error_string(err),
+                     int(fen.size()), fen.data());
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto results = depth > 0 ? perft_divide(board, depth, opt.threads, hash)
+                             : std::vector<RootResult>{};
+    elapsed = seconds_since(start);
+
+    total = depth > 0 ? 0 : 1;
+    for (const auto& r : results) {
+        total += r.nodes;
+        if (opt.divide)
+            std::printf("%-6s %llu\n", r.move.to_uci().c_str(), (unsigned long long)r.nodes);
+    }
+    return true;
+}
+
+void print_speed(uint64_t nodes, double elapsed) {
+    std::printf("time %.3f s  nps %.0f\n", elapsed, elapsed > 0 ? nodes / elapsed : 0.0);
+}
+
+int run_fen(const Options& opt) {
+    PerftHash hash(opt.hash_mb);
+    double elapsed;
+    uint64_t nodes;
+    if (!run_position(opt.fen, opt.depth, opt, hash, nodes, elapsed)) return 2;
+    if (opt.divide) std::printf("\n");
+    std::printf("nodes %llu\n", (unsigned long long)nodes);
+    print_speed(nodes, elapsed);
+    return 0;
+}
+
+int run_epd(const Options& opt) {
+    EpdReader reader;
+    if (!reader.open(opt.epd)) {
+        std::fprintf(stderr, "cannot open %s\n", opt.epd.c_str());
+        return 2;
+    }
+
+    PerftHash hash(opt.hash_mb);
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+    int failures = 0, checks = 0;
+
+    std::vector<EpdRecord> chunk;
+    while (reader.next_chunk(chunk)) {
+        for (const EpdRecord& rec : chunk) {
+            int fen_len = int(rec.fen.size());
+            for_each_epd_op(rec.ops, [&](std::string_view opcode, std::string_view operands) {
+                if (opcode.size() < 2 || opcode[0] != 'D') return;
+                int depth = 0;
+                uint64_t expected = 0;
+                std::from_chars(opcode.data() + 1, opcode.data() + opcode.size(), depth);
+                std::from_chars(operands.data(), operands.data() + operands.size(), expected);
+                if (depth <= 0 || (opt.depth && depth > opt.depth)) return;
+
+                double elapsed;
+                uint64_t nodes = 0;
+                if (!run_position(rec.fen, depth, opt, hash, nodes, elapsed)) {
+                    ++checks;
+                    ++failures;
+                    return;
+                }
+                bool ok = nodes == expected;
+                ++checks;
+                failures += !ok;
+                total_nodes += nodes;
+                total_time += elapsed;
+
+                std::printf("%s D%d %llu %.*s\n", ok ? "ok  " : "FAIL", depth,
+                            (unsigned long long)nodes, fen_len, rec.fen.data());
+                if (!ok) std::printf("      expected %llu\n", (unsigned long long)expected);
+            });
+        }
+    }
+
+    std::printf("\n%d/%d passed, nodes %llu\n", checks - failures, checks,
+                (unsigned long long)total_nodes);
+    print_speed(total_nodes, total_time);
+    return failures ? 1 : 0;
+}
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: chestrat-perft [--divide] [--threads N] [--hash MB] <depth> [fen]\n"
+        "       chestrat-perft [--threads N] [--hash MB] --epd <file> [--depth N]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bb::init();
+
+    Options opt;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--divide")                     opt.divide = true;
+        else if (arg == "--threads" && has_value)  opt.threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--hash" && has_value)     opt.hash_mb = size_t(std::atoll(argv[++i]));
+        else if (arg == "--epd" && has_value)      opt.epd = argv[++i];
+        else if (arg == "--depth" && has_value)    opt.depth = std::atoi(argv[++i]);
+        else if (arg.rfind("--", 0) == 0) { usage(); return 2; }
+        else positional.push_back(arg);
+    }
+
+    if (!opt.epd.empty()) return run_epd(opt);
+
+    if (positional.empty()) { usage(); return 2; }
+    opt.depth = std::atoi(positional[0].c_str());
+    if (positional.size() > 1) {
+        opt.fen.clear();
+        for (size_t i = 1; i < positional.size(); ++i)
+            opt.fen += (i > 1 ? " " : "") + positional[i];
+    }
+    return run_fen(opt);
+}